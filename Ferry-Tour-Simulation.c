@@ -1,517 +1,3197 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <pthread.h>
-#include <semaphore.h>
 #include <unistd.h>
 #include <time.h>
 #include <string.h>
+#include <strings.h>
+#include <math.h>
+#include <stdint.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
-#define CAR_COUNT 25
-#define MINIBUS_COUNT 15
-#define TRUCK_COUNT 10
-#define TOTAL_VEHICLES 50
-#define FERRY_CAPACITY 50
-#define TOLL_PER_SIDE 2
-#define MAX_TRIPS 100
+#define MAX_TRIPS 100 // Initial trip log size, grown on demand
 #define SIDE_A 0
 #define SIDE_B 1
+#define MAX_VEHICLE_CLASSES 8 // Vehicle classes a configuration may define
+#define MAX_FERRIES 8 // Vessels a configuration may define
+#define REACH_WORDS(r) ((r)->limit / 64 + 1)
+#define TRACE_BUFFER_RECORDS 4096 // Per-thread trace records between writes
+#define SNAPSHOT_INTERVAL 0.1 // Seconds between console snapshots
+#define RNG_STREAM_FERRY 0 // Vehicles use their id as stream number
+#define RNG_STREAM_TOLL (1ULL << 32) // Plus the booth index
+#define RNG_STREAM_VESSEL (2ULL << 32) // Plus the vessel index, for every vessel but the first
 
+// SplitMix64 random streams. Every actor draws from its own stream, keyed off the
+// run seed and the actor's stream number, so draws never contend for a lock and
+// never depend on which thread happened to run first.
+typedef struct {
+    uint64_t state;
+} RngStream;
+
+uint64_t rng_next(RngStream *r) {
+    uint64_t z = (r->state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+void rng_seed(RngStream *r, uint64_t seed, uint64_t stream) {
+    RngStream key = {seed ^ (stream * 0xD1B54A32D192ED03ULL)};
+    r->state = rng_next(&key);
+}
+
+// Uniform integer in [0, n)
+int rng_below(RngStream *r, int n) {
+    return (int)(((rng_next(r) >> 32) * (uint64_t)n) >> 32);
+}
+
+// Uniform double in [0, 1)
+double rng_double(RngStream *r) {
+    return (rng_next(r) >> 11) * 0x1.0p-53;
+}
+
+// Configurable durations in seconds
+enum {
+    DIST_FIXED,       // fixed:A (or a bare number)
+    DIST_UNIFORM,     // uniform:A:B, any value in [A, B)
+    DIST_INTEGER,     // int:A:B, whole seconds A..B inclusive
+    DIST_EXPONENTIAL  // exp:A, mean A
+};
+
+typedef struct {
+    int kind;
+    double a, b;
+} Distribution;
+
+double dist_sample(const Distribution *d, RngStream *r) {
+    switch (d->kind) {
+        case DIST_UNIFORM: return d->a + (d->b - d->a) * rng_double(r);
+        case DIST_INTEGER: return d->a + rng_below(r, (int)(d->b - d->a) + 1);
+        case DIST_EXPONENTIAL: return -d->a * log(1 - rng_double(r));
+        default: return d->a;
+    }
+}
+
+double dist_mean(const Distribution *d) {
+    return d->kind == DIST_UNIFORM || d->kind == DIST_INTEGER ? (d->a + d->b) / 2 : d->a;
+}
+
+// Returns -1 unless text is one of the forms above with non-negative bounds
+int parse_distribution(const char *text, Distribution *d) {
+    Distribution r = {DIST_FIXED, 0, 0};
+    int n = -1;
+    if (sscanf(text, "fixed:%lf%n", &r.a, &n) == 1 || sscanf(text, "%lf%n", &r.a, &n) == 1) r.kind = DIST_FIXED;
+    else if (sscanf(text, "uniform:%lf:%lf%n", &r.a, &r.b, &n) == 2) r.kind = DIST_UNIFORM;
+    else if (sscanf(text, "int:%lf:%lf%n", &r.a, &r.b, &n) == 2) r.kind = DIST_INTEGER;
+    else if (sscanf(text, "exp:%lf%n", &r.a, &n) == 1) r.kind = DIST_EXPONENTIAL;
+    if (n < 0 || text[n] != '\0' || r.a < 0) return -1;
+    if ((r.kind == DIST_UNIFORM || r.kind == DIST_INTEGER) && r.b < r.a) return -1;
+    if (r.kind == DIST_INTEGER && (r.a != floor(r.a) || r.b != floor(r.b))) return -1;
+    *d = r;
+    return 0;
+}
+
+// Log-bucketed latency histogram over nanoseconds, HDR style: values below 64
+// get a bucket each, above that every power of two is split into 32 buckets,
+// so a percentile is within about 3% of the true value in constant memory.
+// count, sum, min and max are exact.
+#define HIST_SUB_BITS 5
+#define HIST_MAX_NS ((1LL << 52) - 1) // About 52 days; longer values are clamped
+#define HIST_BUCKETS ((52 - HIST_SUB_BITS + 1) << HIST_SUB_BITS)
+
+typedef struct {
+    long count;
+    int64_t sum, min, max;
+    long buckets[HIST_BUCKETS];
+} LatencyHistogram;
+
+int hist_bucket(int64_t ns) {
+    if (ns < (2 << HIST_SUB_BITS)) return (int)ns;
+    int shift = 63 - __builtin_clzll(ns) - HIST_SUB_BITS;
+    return (shift << HIST_SUB_BITS) + (int)(ns >> shift);
+}
+
+// Lowest value that falls in bucket b
+int64_t hist_bucket_low(int b) {
+    if (b < (2 << HIST_SUB_BITS)) return b;
+    int shift = (b >> HIST_SUB_BITS) - 1;
+    return (int64_t)((b & ((1 << HIST_SUB_BITS) - 1)) + (1 << HIST_SUB_BITS)) << shift;
+}
+
+void hist_record(LatencyHistogram *h, int64_t ns) {
+    if (ns < 0) ns = 0;
+    if (ns > HIST_MAX_NS) ns = HIST_MAX_NS;
+    if (h->count == 0 || ns < h->min) h->min = ns;
+    if (ns > h->max) h->max = ns;
+    h->count++;
+    h->sum += ns;
+    h->buckets[hist_bucket(ns)]++;
+}
+
+void hist_merge(LatencyHistogram *into, const LatencyHistogram *from) {
+    if (from->count == 0) return;
+    if (into->count == 0 || from->min < into->min) into->min = from->min;
+    if (from->max > into->max) into->max = from->max;
+    into->count += from->count;
+    into->sum += from->sum;
+    for (int b = 0; b < HIST_BUCKETS; b++) into->buckets[b] += from->buckets[b];
+}
+
+// Value at quantile q (0.99 for p99) in seconds: the middle of the bucket holding it
+double hist_percentile(const LatencyHistogram *h, double q) {
+    if (h->count == 0) return 0;
+    long rank = (long)ceil(q * h->count), seen = 0;
+    if (rank <= 1) return h->min / 1e9;
+    if (rank >= h->count) return h->max / 1e9;
+    for (int b = 0; b < HIST_BUCKETS; b++) {
+        seen += h->buckets[b];
+        if (seen < rank) continue;
+        int64_t mid = (hist_bucket_low(b) + hist_bucket_low(b + 1) - 1) / 2;
+        if (mid < h->min) mid = h->min;
+        if (mid > h->max) mid = h->max;
+        return mid / 1e9;
+    }
+    return h->max / 1e9;
+}
+
+double hist_mean(const LatencyHistogram *h) {
+    return h->count ? h->sum / 1e9 / h->count : 0;
+}
+
+// Timings recorded per vehicle. Waits and crossings are kept per class and the
+// side they started from; total waits and round trips per class and start port.
+enum {
+    LAT_WAIT,       // Toll booth to boarding
+    LAT_CROSSING,   // Boarding to unloading
+    LAT_TOTAL_WAIT, // Wait at A plus wait at B
+    LAT_ROUND_TRIP,
+    LAT_METRICS
+};
+
+// Vehicle states. Each vehicle is a small state machine stepped by the worker
+// pool (or by the event engine in event mode) instead of owning a thread.
+enum {
+    V_TOLL,     // Heading for a toll booth, or queued at one
+    V_AT_BOOTH, // Paying at its booth
+    V_PAID,     // Payment done, about to free the booth
+    V_WAITING,  // In the square, waiting to board
+    V_ON_FERRY, // Crossing
+    V_DONE      // Round-trip complete
+};
+
+// Vehicles are stored hot and cold. Vehicle holds what the state machines,
+// queues and load planner read on every step, packed into 40 bytes; the
+// timestamps and bookkeeping that only a few transitions and the reports touch
+// live in a parallel VehicleRecord array, indexed the same way.
 typedef struct {
     int id;
-    int type; // 0: Car, 1: Minibus, 2: Truck
-    int capacity; // 1, 2, 4
-    int port; // SIDE_A or SIDE_B
+    uint8_t type; // Index into the configured vehicle classes
+    uint8_t port; // SIDE_A or SIDE_B
+    uint8_t boarded; // 0, 1, 2
+    uint8_t state; // V_TOLL ... V_DONE
+    int capacity; // Units taken on the ferry, from its class
+    int toll; // Toll booth in use
+    int next; // Intrusive link for the run queue, a booth queue or a boarding gate, -1 if last
+    unsigned long square_seq; // Order of joining the square, across classes
+    double ready_time; // Earliest clock_seconds() at which the vehicle may board
+} Vehicle;
+
+typedef struct {
     int start_port; // Initial starting point (X)
-    int boarded; // 0, 1, 2
     int a_trip_no, b_trip_no; // Trip numbers for A->B and B->A
     int returned; // 1 if vehicle completed round-trip
-    time_t wait_start_a, wait_end_a; // Side-A wait times
-    time_t wait_start_b, wait_end_b; // Side-B wait times
-    time_t ferry_start_a, ferry_end_a; // A->B ferry times
-    time_t ferry_start_b, ferry_end_b; // B->A ferry times
-    time_t trip_start, trip_end; // Full round-trip times
-    time_t wait_duration_b; // Random wait time at Side-B
-} Vehicle;
+    // Timestamps in nanoseconds since sim_start_time, from sim_now
+    int64_t wait_start_a, wait_end_a; // Side-A wait times
+    int64_t wait_start_b, wait_end_b; // Side-B wait times
+    int64_t ferry_start_a, ferry_end_a; // A->B ferry times
+    int64_t ferry_start_b, ferry_end_b; // B->A ferry times
+    int64_t trip_start, trip_end; // Full round-trip times
+    double wait_duration_b; // Random wait time at Side-B
+    RngStream rng; // Toll choice and dwell time at Side-B
+} VehicleRecord;
+
+typedef struct {
+    char name[16];
+    int capacity; // Ferry units one vehicle takes
+    int count;
+} VehicleClass;
+
+typedef struct {
+    int trip_id;
+    int direction; // 0: A->B, 1: B->A
+    double duration;
+    int manifest_offset; // First of this trip's ids in manifest_ids
+    int vehicle_count;
+    int capacity_used;
+    int fcfs_capacity; // Load first-come-first-served boarding would have reached
+    int ferry; // Vessel index
+} Trip;
+
+// Vehicles at one side that still have to board there, and the loads they can make up
+typedef struct {
+    int count[MAX_VEHICLE_CLASSES]; // Per vehicle type
+    const VehicleClass *classes; // The run's class table, for unit sizes
+    int class_count;
+    int limit; // Largest load tracked, the ferry capacity
+    uint64_t *bits; // REACH_WORDS words. Bit k set: some subset of these vehicles takes exactly k units
+    int dirty; // bits must be rebuilt from count[] after a vehicle left
+} Reachability;
+
+
+// Discrete-event mode
+typedef enum {
+    // Events sharing a timestamp run in this order, so unloads and returns
+    // are visible to a departure check scheduled for the same instant.
+    EV_ARRIVE,     // Ferry reaches the other side and asks for a berth
+    EV_UNLOAD,     // Vehicle drives off the ferry
+    EV_RETURN,     // Vehicle completes its round-trip
+    EV_TOLL_ENTRY, // Vehicle reaches a toll booth
+    EV_TOLL_EXIT,  // Vehicle leaves the booth for the square
+    EV_BOARD,      // Vehicle is ready to board
+    EV_DEPART,     // Ferry departure check
+    EV_TOLL_SCALE  // Plaza controller opens or closes booths
+} EventType;
+
+typedef struct {
+    double time; // Virtual seconds since sim_start_time
+    int type;
+    int vehicle; // Index into vehicles[], or into ferries[] for EV_ARRIVE and EV_DEPART
+    unsigned long seq; // Insertion order, breaks remaining ties
+} Event;
+
+
+// Binary event trace (--trace): fixed-width records, buffered per thread and
+// written at offsets claimed with an atomic add, so writers never share a lock
+typedef enum {
+    TR_TOLL_QUEUE = 1, // Vehicle reaches a toll booth; aux is the booth
+    TR_TOLL_START,     // Vehicle starts paying; aux is the booth
+    TR_TOLL_EXIT,      // Vehicle leaves the booth
+    TR_SQUARE,         // Vehicle joins the square
+    TR_BOARD,          // Vehicle boards; load includes it
+    TR_DEPART,         // Ferry leaves side; aux is the FCFS load
+    TR_DOCK,           // Ferry gets a berth at side and unloads
+    TR_UNLOAD,         // Vehicle drives off at side
+    TR_RETURNED,       // Vehicle completes its round-trip
+    TR_ARRIVE          // Ferry reaches side, before it gets a berth
+} TraceType;
+
+typedef struct {
+    char magic[8]; // "FERRYTR1"
+    uint32_t record_size;
+    int32_t vehicles;
+    int64_t start_time; // sim_start_time
+    int32_t ferry_capacity; // Largest vessel
+    int32_t ferries; // 0 in traces from before fleets, meaning 1
+} TraceHeader;
+
+typedef struct {
+    double time;     // clock_seconds() at the transition
+    int32_t vehicle; // Vehicle id, -1 for ferry events
+    int32_t trip;    // The vessel's trip id, -1 for events without a vessel
+    int32_t load;    // Vessel load after the event
+    int32_t aux;
+    uint8_t type;    // TraceType, 0 in a hole left by a thread that never flushed
+    uint8_t side;
+    uint8_t ferry;   // Vessel index
+    uint8_t pad[5];
+} TraceRecord;
+
+typedef struct {
+    int count;
+    TraceRecord records[TRACE_BUFFER_RECORDS];
+} TraceBuffer;
+
+__thread TraceBuffer *trace_buffer = NULL;
+
+// Each thread records timings into its own histograms, without a lock, and
+// merges them into the simulation's once it is done
+__thread LatencyHistogram *latency_local = NULL;
+
+// The simulation-wide mutexes that -DLOCK_PROFILE instruments
+enum {
+    LK_BOARDING, // boarding_mutex: square, ferry load and departure
+    LK_PRINT,    // print_mutex: stdout
+    LK_RETURN,   // return_mutex: returned vehicles
+    LK_LOG,      // log_mutex: trip log and merged histograms
+    LK_LOCKS
+};
+
+#ifdef LOCK_PROFILE
+#define LOCK_SITES 16 // Call sites tracked per lock; acquisitions from more still count in the totals
+
+typedef struct {
+    const char *func; // NULL while the slot is free
+    int line;
+    long count, contended;
+    int64_t wait; // Nanoseconds spent blocked here
+} LockSite;
+
+// Updated only by the thread holding the lock, so it needs no lock of its own
+typedef struct {
+    long count, contended; // Acquisitions, and those that found the lock taken
+    LatencyHistogram wait; // Per lock call: 0 if uncontended, else the time blocked
+    LatencyHistogram hold; // Acquisition to release, excluding condvar waits
+    int64_t held_since;
+    LockSite sites[LOCK_SITES];
+} LockProfile;
+#endif
+
+// What the console shows. The ferry thread copies it out of the live state, so
+// drawing a frame costs the same at any fleet size and never takes a lock.
+typedef struct {
+    long elapsed; // Seconds since the start
+    int trip_id;
+    int ferry_side[MAX_FERRIES], ferry_state[MAX_FERRIES], ferry_load[MAX_FERRIES];
+    int load, returned; // load is the whole fleet's
+    int waiting[2][MAX_VEHICLE_CLASSES]; // Vehicles still to board at each side, per class
+    int on_board[MAX_VEHICLE_CLASSES]; // Over the whole fleet
+} StateSnapshot;
+
+#define SNAPSHOT_WORDS ((sizeof(StateSnapshot) + sizeof(uint64_t) - 1) / sizeof(uint64_t))
+
+// How an arriving vehicle picks a booth on its side
+enum {
+    TOLL_RANDOM,   // Uniformly at random
+    TOLL_SHORTEST, // Join the shortest queue, scanning every booth
+    TOLL_TWO       // The shorter of two random booths
+};
+
+enum {
+    DEPART_PLANNED, // As soon as waiting longer can't raise the planned load
+    DEPART_FULL     // Only with a full ferry, or once the checks run out
+};
+
+// One vessel of the fleet, as configured
+typedef struct {
+    char name[16];
+    int capacity; // Units
+    double speed; // Crossing times are divided by it
+} VesselSpec;
+
+// Run parameters, fixed when the simulation is created
+typedef struct {
+    VehicleClass classes[MAX_VEHICLE_CLASSES];
+    int class_count;
+    int ferry_capacity; // The lone vessel's without FERRY lines; within a simulation, the largest vessel's
+    VesselSpec vessels[MAX_FERRIES]; // FERRY lines; none means one vessel of ferry_capacity
+    int vessel_count;
+    int berths; // Vessels that can dock at each side at once
+    int toll_per_side;
+    int toll_policy; // TOLL_RANDOM, TOLL_SHORTEST or TOLL_TWO
+    int toll_autoscale; // Open and close booths with the load; toll_per_side is then the most per side
+    int toll_min_open; // Booths per side that never close
+    double toll_scale_up, toll_scale_down; // Backlog drain times in seconds, see plaza_control
+    double toll_scale_interval; // Seconds between controller runs
+    Distribution toll_service; // Time paying at a booth
+    Distribution crossing_time;
+    Distribution dwell_time; // Rest at Side-B before the return
+    int departure_policy; // DEPART_PLANNED or DEPART_FULL
+    int max_ferry_checks; // Departure checks before the ferry leaves anyway
+    double poll_interval; // Seconds between departure checks
+    int event_mode; // Virtual clock instead of wall time and threads
+    int vehicle_table; // Keep every vehicle's timings for the per-vehicle tables
+    uint64_t seed; // Root of every random stream in the run
+} SimConfig;
+
+// A toll booth: its FIFO of vehicles and what it has done. Each booth has its
+// own mutex (real-time mode) and cache line, so vehicles at different booths
+// share neither, and booth selection only reads load, without a lock.
+typedef struct {
+    pthread_mutex_t mutex;
+    int busy; // A vehicle is being served
+    int head, tail; // Vehicles queued behind it, linked through Vehicle.next
+    int load; // Queued plus in service; written under mutex, read atomically
+    int max_queue;
+    long served;
+    int64_t busy_ns; // Time serving
+    int64_t queue_ns; // Integral of the queue length over time, in vehicle-nanoseconds
+    int64_t changed; // sim_now of the last change to busy or the queue
+    int64_t opened_at; // sim_now when the booth was last staffed, -1 while unstaffed; under mutex
+    int64_t open_ns; // Staffed time up to opened_at; under mutex
+    int closing; // Closed to arrivals but still serving; unstaffed once empty
+    RngStream rng; // Service times
+} __attribute__((aligned(64))) TollBooth;
+
+enum {
+    FERRY_DOCKED,   // Holds a berth at side and boards
+    FERRY_CROSSING, // Left side
+    FERRY_WAITING   // Reached side, queued for a berth
+};
+
+// One vessel. Vessels docked at the same side share its square; boarding only
+// happens under boarding_mutex (or on the event thread), so two of them never
+// take the same vehicle.
+typedef struct {
+    VesselSpec spec;
+    int state;
+    int side;
+    int load; // Units on board
+    int *boarded_ids; // spec.capacity slots: every vehicle takes at least one unit
+    int boarded_count;
+    int trip_id; // Of the trip being loaded or crossed
+    int first_return; // The first trip back from Side-B leaves empty
+    int checks; // Departure checks at this berth, event mode
+    int next; // Next vessel queued for the same berth
+    int64_t queued_at; // sim_now when it started waiting for a berth
+    int64_t berth_wait_ns; // Total time spent waiting for berths
+    RngStream rng; // Crossing durations
+    pthread_cond_t full; // Real-time mode: the square can fill it, or it got its berth
+} Ferry;
+
+// A vehicle the load planner may board
+typedef struct {
+    double waited; // Seconds since it reached the toll
+    unsigned long square_seq;
+    int vehicle;
+} PlanCandidate;
+
+// Everything one simulation run owns. Independent simulations share nothing but
+// stdout, so any number of them can run side by side in one process.
+typedef struct {
+    SimConfig config;
+    int total_vehicles;
+    Vehicle *vehicles;
+    VehicleRecord *records; // Cold half of vehicles[], same index
+    Trip *trip_log;
+    int trip_count, trip_log_size;
+    int *manifest_ids; // Append-only arena of every trip's vehicle ids
+    int manifest_count, manifest_size;
+    Ferry *ferries;
+    int ferry_count;
+    int berths_free[2];
+    int berth_head[2], berth_tail[2]; // FIFO of vessels waiting for a berth at each side
+    char type_label[MAX_VEHICLE_CLASSES][48]; // Coloured class names for the console
+    int total_returned;
+    int current_trip_id; // Trips departed so far, the id of the next one
+    int is_first_return; // The first departure from Side-B is special, see ferry_func and EV_DEPART
+    int final_trip_done; // Set under boarding_mutex and return_mutex; polled atomically without them
+    int gate_head[2][MAX_VEHICLE_CLASSES], gate_tail[2][MAX_VEHICLE_CLASSES]; // FIFO per class of each side's square
+    unsigned long square_seq; // Next Vehicle.square_seq
+    Reachability side_reach[2]; // Vehicles at a side that still have to board
+    Reachability gate_reach[2]; // Vehicles in the square, ready to board
+    Event *resting[2]; // Min-heap on ready_time of vehicles landed at each side, possibly still resting
+    int resting_count[2], resting_size[2];
+    double *planner_prefix, *planner_wait; // Load planner tables, see board_planned_load; planner_wait has two rows
+    int *planner_take;
+    PlanCandidate *planner_pick; // Per class, the candidates board_planned_load looks at
+    double *wait_time_a, *wait_time_b; // Per-vehicle timings, NULL without vehicle_table
+    double *ferry_time_a, *ferry_time_b;
+    double *round_trip_time;
+    LatencyHistogram *latency; // See latency_hist; recording threads merge theirs in on exit
+    time_t sim_start_time; // Wall-clock start; every timestamp is an offset from it
+
+    // Discrete-event mode
+    double sim_clock; // Virtual clock in seconds
+    Event *event_queue; // Binary min-heap
+    int event_count, event_queue_size;
+    unsigned long event_seq;
+
+    // Binary event trace
+    int trace_fd; // -1 when not tracing
+    off_t trace_offset; // End of the claimed part of the file
+
+    // Toll plaza, shared by both modes: 2 * toll_per_side booths, Side-A's first
+    TollBooth *booths;
+    int toll_open[2]; // Open booths per side: the first toll_open[side] of its booths
+
+    // Actor runtime (real-time mode): a fixed pool of workers steps vehicle state machines
+    int worker_count;
+    int run_head, run_tail; // Runnable vehicles
+    Event *actor_timers; // Sleeping vehicles, min-heap on wake time
+    int actor_timer_count, actor_timer_size;
+    unsigned long actor_timer_seq;
+    int runtime_stopped;
+    struct timespec runtime_start; // CLOCK_MONOTONIC at sim_start_time, origin of sim_now
+
+    // Synchronization primitives
+    pthread_mutex_t boarding_mutex;
+    pthread_mutex_t return_mutex;
+    pthread_mutex_t log_mutex;
+    pthread_mutex_t sched_mutex; // Run queue and actor timers
+    pthread_cond_t sched_cond; // Idle workers, CLOCK_MONOTONIC
+    unsigned long boarding_lock_count; // boarding_mutex acquisitions, including condvar wakeups
+    unsigned snapshot_seq; // Seqlock over snapshot: odd while the ferry thread is writing it
+    uint64_t snapshot[SNAPSHOT_WORDS]; // A StateSnapshot, stored word by word, see publish_snapshot
+    double snapshot_time; // clock_seconds() of the last publish
+#ifdef LOCK_PROFILE
+    LockProfile *lock_profile; // LK_LOCKS entries
+#endif
+} Simulation;
+
+pthread_mutex_t print_mutex = PTHREAD_MUTEX_INITIALIZER; // stdout is shared by every simulation
+
+// Lock and unlock the mutexes listed in LK_*. Plain pthread calls unless built
+// with -DLOCK_PROFILE, which times every acquisition and hold and attributes
+// them to the calling function and line for print_lock_profile.
+#ifdef LOCK_PROFILE
+int64_t lock_clock_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+LockSite *lock_site(LockProfile *p, const char *func, int line) {
+    for (int k = 0; k < LOCK_SITES; k++) {
+        LockSite *site = &p->sites[k];
+        if (!site->func) *site = (LockSite){.func = func, .line = line};
+        if (site->line == line && site->func == func) return site;
+    }
+    return NULL;
+}
+
+void profiled_lock(Simulation *sim, int lock, pthread_mutex_t *m, const char *func, int line) {
+    int64_t start = 0, now;
+    int contended = pthread_mutex_trylock(m) != 0;
+    if (contended) {
+        start = lock_clock_ns();
+        pthread_mutex_lock(m);
+    }
+    now = lock_clock_ns();
+    LockProfile *p = &sim->lock_profile[lock];
+    int64_t wait = contended ? now - start : 0;
+    p->count++;
+    p->contended += contended;
+    hist_record(&p->wait, wait);
+    LockSite *site = lock_site(p, func, line);
+    if (site) {
+        site->count++;
+        site->contended += contended;
+        site->wait += wait;
+    }
+    p->held_since = now;
+}
+
+void profiled_unlock(Simulation *sim, int lock, pthread_mutex_t *m) {
+    LockProfile *p = &sim->lock_profile[lock];
+    hist_record(&p->hold, lock_clock_ns() - p->held_since);
+    pthread_mutex_unlock(m);
+}
+
+// The wait releases the lock, so it ends one hold; the wakeup counts as an
+// acquisition, but its blocking can't be told apart from the sleep
+int profiled_cond_timedwait(Simulation *sim, int lock, pthread_cond_t *c, pthread_mutex_t *m,
+                            const struct timespec *until, const char *func, int line) {
+    LockProfile *p = &sim->lock_profile[lock];
+    hist_record(&p->hold, lock_clock_ns() - p->held_since);
+    int status = pthread_cond_timedwait(c, m, until);
+    p->count++;
+    LockSite *site = lock_site(p, func, line);
+    if (site) site->count++;
+    p->held_since = lock_clock_ns();
+    return status;
+}
+
+#define LOCK_MUTEX(sim, lock, m) profiled_lock(sim, lock, m, __func__, __LINE__)
+#define UNLOCK_MUTEX(sim, lock, m) profiled_unlock(sim, lock, m)
+#define COND_TIMEDWAIT(sim, lock, c, m, until) profiled_cond_timedwait(sim, lock, c, m, until, __func__, __LINE__)
+#else
+#define LOCK_MUTEX(sim, lock, m) pthread_mutex_lock(m)
+#define UNLOCK_MUTEX(sim, lock, m) pthread_mutex_unlock(m)
+#define COND_TIMEDWAIT(sim, lock, c, m, until) pthread_cond_timedwait(c, m, until)
+#endif
+
+
+// Helper functions
+const char* get_type_name(Simulation *sim, int type) {
+    return sim->type_label[type];
+}
+
+// Without colour codes, for machine-readable output
+const char* get_class_name(Simulation *sim, int type) {
+    return sim->config.classes[type].name;
+}
+
+// Ids are handed out densely from 1 in main, so an id indexes the vehicle table directly
+Vehicle *vehicle_by_id(Simulation *sim, int id) {
+    return &sim->vehicles[id - 1];
+}
+
+VehicleRecord *vehicle_record(Simulation *sim, Vehicle *v) {
+    return &sim->records[v->id - 1];
+}
+
+// Nanoseconds since sim_start_time on the active clock: CLOCK_MONOTONIC, which
+// is read through the vDSO without a system call and never jumps with the wall
+// clock, or the virtual clock in event mode. Cheap enough to stamp every transition.
+int64_t sim_now(Simulation *sim) {
+    if (sim->config.event_mode) return llround(sim->sim_clock * 1e9);
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)(now.tv_sec - sim->runtime_start.tv_sec) * 1000000000 + (now.tv_nsec - sim->runtime_start.tv_nsec);
+}
+
+double ns_to_seconds(int64_t ns) {
+    return ns / 1e9;
+}
+
+// Seconds since the start of the run on the active clock
+double clock_seconds(Simulation *sim) {
+    if (sim->config.event_mode) return sim->sim_clock;
+    return ns_to_seconds(sim_now(sim));
+}
+
+void trace_flush(Simulation *sim) {
+    TraceBuffer *b = trace_buffer;
+    if (!b || b->count == 0) return;
+    size_t bytes = sizeof(TraceRecord) * b->count;
+    off_t at = __atomic_fetch_add(&sim->trace_offset, (off_t)bytes, __ATOMIC_RELAXED);
+    if (pwrite(sim->trace_fd, b->records, bytes, at) != (ssize_t)bytes)
+        fprintf(stderr, "Error: trace write failed\n");
+    b->count = 0;
+}
+
+// Vehicle index i, or -1 for ferry events; f is the vessel involved, or NULL
+void trace_event(Simulation *sim, Ferry *f, int type, int i, int side, int aux) {
+    if (sim->trace_fd < 0) return;
+    if (!trace_buffer) {
+        trace_buffer = malloc(sizeof(TraceBuffer));
+        trace_buffer->count = 0;
+    }
+    // Designated fields: the padding comes out zeroed
+    trace_buffer->records[trace_buffer->count++] = (TraceRecord){
+        .time = clock_seconds(sim), .vehicle = i >= 0 ? sim->vehicles[i].id : -1, .trip = f ? f->trip_id : -1,
+        .load = f ? f->load : 0, .aux = aux, .type = type, .side = side, .ferry = f ? f - sim->ferries : 0};
+    if (trace_buffer->count == TRACE_BUFFER_RECORDS) trace_flush(sim);
+}
+
+// Each tracing thread calls this once it is done
+void trace_thread_exit(Simulation *sim) {
+    if (sim->trace_fd < 0) return;
+    trace_flush(sim);
+    free(trace_buffer);
+    trace_buffer = NULL;
+}
+
+// Histogram for one metric, class and side in a set laid out like sim->latency
+LatencyHistogram *latency_hist(Simulation *sim, LatencyHistogram *set, int metric, int type, int side) {
+    return &set[(metric * sim->config.class_count + type) * 2 + side];
+}
+
+void record_latency(Simulation *sim, int metric, int type, int side, int64_t ns) {
+    if (!latency_local) {
+        latency_local = calloc((size_t)LAT_METRICS * sim->config.class_count * 2, sizeof(LatencyHistogram));
+        if (!latency_local) return;
+    }
+    hist_record(latency_hist(sim, latency_local, metric, type, side), ns);
+}
+
+// Each recording thread calls this once it is done
+void latency_thread_exit(Simulation *sim) {
+    if (!latency_local) return;
+    LOCK_MUTEX(sim, LK_LOG, &sim->log_mutex);
+    for (int k = 0; k < LAT_METRICS * sim->config.class_count * 2; k++) hist_merge(&sim->latency[k], &latency_local[k]);
+    UNLOCK_MUTEX(sim, LK_LOG, &sim->log_mutex);
+    free(latency_local);
+    latency_local = NULL;
+}
+
+// Record one of a vehicle's timings: always in the histograms, and in the
+// per-vehicle table when there is one. side is where the wait or crossing
+// began, or the start port for the whole-trip metrics.
+void record_vehicle_time(Simulation *sim, Vehicle *v, int metric, int side, int64_t ns) {
+    record_latency(sim, metric, v->type, side, ns);
+    if (!sim->config.vehicle_table) return;
+    double *table[LAT_METRICS][2] = {{sim->wait_time_a, sim->wait_time_b}, {sim->ferry_time_a, sim->ferry_time_b},
+                                     {NULL, NULL}, {sim->round_trip_time, sim->round_trip_time}};
+    if (table[metric][side]) table[metric][side][v->id - 1] = ns_to_seconds(ns);
+}
+
+// A vehicle is back where it started
+void record_return(Simulation *sim, Vehicle *v) {
+    VehicleRecord *rec = vehicle_record(sim, v);
+    rec->trip_end = sim_now(sim);
+    record_vehicle_time(sim, v, LAT_ROUND_TRIP, rec->start_port, rec->trip_end - rec->trip_start);
+    record_vehicle_time(sim, v, LAT_TOTAL_WAIT, rec->start_port,
+                        (rec->wait_end_a - rec->wait_start_a) + (rec->wait_end_b - rec->wait_start_b));
+}
+
+// One metric over every class and side
+LatencyHistogram latency_total(Simulation *sim, int metric) {
+    LatencyHistogram total = {0};
+    for (int c = 0; c < sim->config.class_count; c++)
+        for (int side = 0; side < 2; side++) hist_merge(&total, latency_hist(sim, sim->latency, metric, c, side));
+    return total;
+}
+
+int trace_open(Simulation *sim, const char *path) {
+    sim->trace_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (sim->trace_fd < 0) return -1;
+    TraceHeader h = {"FERRYTR1", sizeof(TraceRecord), sim->total_vehicles, sim->sim_start_time, sim->config.ferry_capacity,
+                     sim->ferry_count};
+    if (pwrite(sim->trace_fd, &h, sizeof(h), 0) != sizeof(h)) return -1;
+    sim->trace_offset = sizeof(h);
+    return 0;
+}
+
+void trace_close(Simulation *sim) {
+    if (sim->trace_fd < 0) return;
+    close(sim->trace_fd);
+    sim->trace_fd = -1;
+}
+
+// Read-only view of a trace file; records are used in place
+typedef struct {
+    void *base;
+    size_t size;
+    TraceHeader *header;
+    TraceRecord *records;
+    long count;
+} TraceReader;
+
+int trace_map(TraceReader *r, const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(TraceHeader)) {
+        close(fd);
+        return -1;
+    }
+    r->size = st.st_size;
+    r->base = mmap(NULL, r->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (r->base == MAP_FAILED) return -1;
+    r->header = r->base;
+    if (memcmp(r->header->magic, "FERRYTR1", 8) != 0 || r->header->record_size != sizeof(TraceRecord)) {
+        munmap(r->base, r->size);
+        return -1;
+    }
+    r->records = (TraceRecord *)(r->header + 1);
+    r->count = (r->size - sizeof(TraceHeader)) / sizeof(TraceRecord);
+    madvise(r->base, r->size, MADV_SEQUENTIAL);
+    return 0;
+}
+
+void trace_unmap(TraceReader *r) {
+    munmap(r->base, r->size);
+}
+
+int event_before(Event *a, Event *b) {
+    if (a->time != b->time) return a->time < b->time;
+    if (a->type != b->type) return a->type < b->type;
+    return a->seq < b->seq;
+}
+
+// Binary min-heap of events ordered by (time, type, seq), grown on demand
+void heap_push(Event **heap, int *count, int *size, Event e) {
+    if (*count == *size) {
+        *size = *size ? *size * 2 : 64;
+        *heap = realloc(*heap, sizeof(Event) * *size);
+    }
+    Event *h = *heap;
+    int i = (*count)++;
+    h[i] = e;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!event_before(&h[i], &h[parent])) break;
+        Event tmp = h[i];
+        h[i] = h[parent];
+        h[parent] = tmp;
+        i = parent;
+    }
+}
+
+int heap_pop(Event *h, int *count, Event *out) {
+    if (*count == 0) return 0;
+    *out = h[0];
+    h[0] = h[--(*count)];
+    int i = 0;
+    while (1) {
+        int l = 2 * i + 1, r = l + 1, m = i;
+        if (l < *count && event_before(&h[l], &h[m])) m = l;
+        if (r < *count && event_before(&h[r], &h[m])) m = r;
+        if (m == i) break;
+        Event tmp = h[i];
+        h[i] = h[m];
+        h[m] = tmp;
+        i = m;
+    }
+    return 1;
+}
+
+// Log f's current trip and manifest, in arrays that double when full so a run needs no per-trip allocation
+void log_trip(Simulation *sim, Ferry *f, double duration, int fcfs_capacity) {
+    int count = f->boarded_count;
+    LOCK_MUTEX(sim, LK_LOG, &sim->log_mutex);
+    if (sim->trip_count == sim->trip_log_size) {
+        sim->trip_log_size = sim->trip_log_size ? sim->trip_log_size * 2 : MAX_TRIPS;
+        sim->trip_log = realloc(sim->trip_log, sizeof(Trip) * sim->trip_log_size);
+    }
+    while (sim->manifest_count + count > sim->manifest_size) {
+        sim->manifest_size = sim->manifest_size ? sim->manifest_size * 2 : MAX_TRIPS * sim->config.ferry_capacity / 4;
+        sim->manifest_ids = realloc(sim->manifest_ids, sizeof(int) * sim->manifest_size);
+    }
+    Trip *t = &sim->trip_log[sim->trip_count++];
+    t->trip_id = f->trip_id;
+    t->direction = f->side;
+    t->duration = duration;
+    t->manifest_offset = sim->manifest_count;
+    t->vehicle_count = count;
+    t->capacity_used = f->load;
+    t->fcfs_capacity = fcfs_capacity;
+    t->ferry = f - sim->ferries;
+    memcpy(sim->manifest_ids + sim->manifest_count, f->boarded_ids, sizeof(int) * count);
+    sim->manifest_count += count;
+    UNLOCK_MUTEX(sim, LK_LOG, &sim->log_mutex);
+    trace_event(sim, f, TR_DEPART, -1, f->side, fcfs_capacity);
+}
+
+// Capacity of the vessel that made trip t
+int trip_capacity(Simulation *sim, Trip *t) {
+    return sim->ferries[t->ferry].spec.capacity;
+}
+
+// ", Name" after the direction in trip summaries, only when there is a fleet
+const char *trip_vessel(Simulation *sim, Trip *t, char buf[32]) {
+    if (sim->ferry_count == 1) return "";
+    snprintf(buf, 32, ", %s", sim->ferries[t->ferry].spec.name);
+    return buf;
+}
+
+// Only valid until the next log_trip, which may move the arena
+int *trip_vehicle_ids(Simulation *sim, Trip *t) {
+    return sim->manifest_ids + t->manifest_offset;
+}
+
+void free_trip_log(Simulation *sim) {
+    free(sim->trip_log);
+    free(sim->manifest_ids);
+}
+
+// bits |= bits << shift, limited to r->limit. Two flat word loops so the
+// compiler can vectorize them.
+void reach_shift_or(Reachability *r, int shift) {
+    int words = REACH_WORDS(r);
+    uint64_t *bits = r->bits, shifted[words];
+    int ws = shift / 64, bs = shift % 64;
+    for (int w = 0; w < words; w++) {
+        uint64_t lo = w - ws >= 0 ? bits[w - ws] : 0;
+        uint64_t carry = bs && w - ws - 1 >= 0 ? bits[w - ws - 1] >> (64 - bs) : 0;
+        shifted[w] = (lo << bs) | carry;
+    }
+    for (int w = 0; w < words; w++) bits[w] |= shifted[w];
+    bits[words - 1] &= ~0ULL >> (63 - r->limit % 64);
+}
+
+// Recompute the reachable loads: each class is added with binary splitting, so
+// the cost is O(classes * log(count) * REACH_WORDS) whatever the queue length
+void reach_rebuild(Reachability *r) {
+    memset(r->bits, 0, sizeof(uint64_t) * REACH_WORDS(r));
+    r->bits[0] = 1;
+    for (int c = 0; c < r->class_count; c++) {
+        int left = r->count[c], cap = r->classes[c].capacity;
+        for (int k = 1; left > 0 && cap <= r->limit; k *= 2) {
+            int take = left < k ? left : k;
+            reach_shift_or(r, take * cap);
+            left -= take;
+            if ((long)k * cap > r->limit) break; // Enough chunks to cover any load
+        }
+    }
+    r->dirty = 0;
+}
+
+// A vehicle joins the set: one shift-OR while the bitset is current
+void reach_add(Reachability *r, int type) {
+    r->count[type]++;
+    if (!r->dirty) reach_shift_or(r, r->classes[type].capacity);
+}
+
+// A vehicle leaves the set by boarding; removal can't be undone in place
+void reach_remove(Reachability *r, int type) {
+    r->count[type]--;
+    r->dirty = 1;
+}
+
+// Largest load <= remaining that the vehicles in the set can make up
+int best_fill(Reachability *r, int remaining) {
+    if (r->dirty) reach_rebuild(r);
+    if (remaining > r->limit) remaining = r->limit;
+    int w = remaining / 64;
+    uint64_t word = r->bits[w] & (~0ULL >> (63 - remaining % 64));
+    while (!word && w > 0) word = r->bits[--w];
+    return word ? w * 64 + 63 - __builtin_clzll(word) : 0;
+}
+
+// Toll plaza. Loads are read without a lock, so two vehicles choosing at once
+// may both pick the same booth; the choice is only a heuristic and the queues
+// stay exact.
+int booth_load(Simulation *sim, int booth) {
+    return __atomic_load_n(&sim->booths[booth].load, __ATOMIC_RELAXED);
+}
+
+// Open booth for a vehicle arriving at side, chosen by toll_policy with the vehicle's stream
+int toll_choose(Simulation *sim, int side, RngStream *r) {
+    int n = __atomic_load_n(&sim->toll_open[side], __ATOMIC_RELAXED), first = side * sim->config.toll_per_side;
+    if (sim->config.toll_policy == TOLL_RANDOM || n == 1) return first + rng_below(r, n);
+    if (sim->config.toll_policy == TOLL_TWO) {
+        int a = rng_below(r, n), b = rng_below(r, n - 1);
+        if (b >= a) b++;
+        return first + (booth_load(sim, first + b) < booth_load(sim, first + a) ? b : a);
+    }
+    // Scan from a random booth so ties don't all go to the first one
+    int start = rng_below(r, n), best = first + start;
+    for (int k = 1; k < n; k++) {
+        int booth = first + (start + k) % n;
+        if (booth_load(sim, booth) < booth_load(sim, best)) best = booth;
+    }
+    return best;
+}
+
+// Bring a booth's busy time and queue integral up to now, before it changes
+void booth_advance(TollBooth *b, int64_t now) {
+    if (b->busy) __atomic_store_n(&b->busy_ns, b->busy_ns + now - b->changed, __ATOMIC_RELAXED);
+    b->queue_ns += (int64_t)(b->load - b->busy) * (now - b->changed);
+    b->changed = now;
+}
+
+// Staffing, with the booth's mutex held. A booth is staffed from when it opens
+// until it has closed and served every vehicle already at it.
+void booth_staff(TollBooth *b, int64_t now) {
+    if (b->opened_at < 0) b->opened_at = now;
+    b->closing = 0;
+}
+
+void booth_unstaff(TollBooth *b, int64_t now) {
+    b->open_ns += now - b->opened_at;
+    b->opened_at = -1;
+    b->closing = 0;
+}
+
+// Vehicle i reaches booth. Returns 1 if it is served right away, 0 if it
+// queued; the vehicle ahead of it hands the booth over in booth_leave.
+int booth_arrive(Simulation *sim, int booth, int i) {
+    TollBooth *b = &sim->booths[booth];
+    if (!sim->config.event_mode) pthread_mutex_lock(&b->mutex);
+    int64_t now = sim_now(sim);
+    booth_advance(b, now);
+    // It chose the booth just before the plaza closed it, and is served all the same
+    if (b->opened_at < 0) {
+        booth_staff(b, now);
+        b->closing = 1;
+    }
+    __atomic_store_n(&b->load, b->load + 1, __ATOMIC_RELAXED);
+    int served = !b->busy;
+    if (served) {
+        b->busy = 1;
+    } else {
+        sim->vehicles[i].next = -1;
+        if (b->tail < 0) b->head = i;
+        else sim->vehicles[b->tail].next = i;
+        b->tail = i;
+        if (b->load - 1 > b->max_queue) b->max_queue = b->load - 1;
+    }
+    if (!sim->config.event_mode) pthread_mutex_unlock(&b->mutex);
+    return served;
+}
+
+// The vehicle at booth has paid. Returns the next vehicle to serve, or -1 if
+// the booth is now free.
+int booth_leave(Simulation *sim, int booth) {
+    TollBooth *b = &sim->booths[booth];
+    if (!sim->config.event_mode) pthread_mutex_lock(&b->mutex);
+    int64_t now = sim_now(sim);
+    booth_advance(b, now);
+    __atomic_store_n(&b->load, b->load - 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&b->served, b->served + 1, __ATOMIC_RELAXED);
+    if (b->closing && b->load == 0) booth_unstaff(b, now);
+    int next = b->head;
+    if (next >= 0) {
+        b->head = sim->vehicles[next].next;
+        if (b->head < 0) b->tail = -1;
+    } else {
+        b->busy = 0;
+    }
+    if (!sim->config.event_mode) pthread_mutex_unlock(&b->mutex);
+    return next;
+}
+
+// Booth dst opened and is staffed from now: drivers at the back of booth src's
+// queue change lanes, so the back half moves to dst if it is empty. Returns the
+// vehicle dst serves first, or -1 if nobody moved.
+int booth_split(Simulation *sim, int src, int dst) {
+    TollBooth *from = &sim->booths[src], *to = &sim->booths[dst];
+    if (!sim->config.event_mode) {
+        pthread_mutex_lock(&from->mutex);
+        pthread_mutex_lock(&to->mutex);
+    }
+    int64_t now = sim_now(sim);
+    booth_advance(from, now);
+    booth_advance(to, now);
+    booth_staff(to, now);
+    int queued = from->load - from->busy, moved = queued / 2, first = -1;
+    if (moved > 0 && !to->busy && to->load == 0) {
+        int last = from->head; // Last vehicle that stays
+        for (int k = 1; k < queued - moved; k++) last = sim->vehicles[last].next;
+        first = sim->vehicles[last].next;
+        sim->vehicles[last].next = -1;
+        for (int i = first; i >= 0; i = sim->vehicles[i].next) sim->vehicles[i].toll = dst;
+        to->head = sim->vehicles[first].next;
+        to->tail = to->head < 0 ? -1 : from->tail;
+        from->tail = last;
+        to->busy = 1;
+        to->max_queue = moved - 1 > to->max_queue ? moved - 1 : to->max_queue;
+        __atomic_store_n(&from->load, from->load - moved, __ATOMIC_RELAXED);
+        __atomic_store_n(&to->load, moved, __ATOMIC_RELAXED);
+    }
+    if (!sim->config.event_mode) {
+        pthread_mutex_unlock(&to->mutex);
+        pthread_mutex_unlock(&from->mutex);
+    }
+    return first;
+}
+
+// Plaza controller, run every toll_scale_interval with autoscaling on. At the
+// mean service time observed so far, a side's backlog would take
+// load * mean / open seconds to clear. Above toll_scale_up the next booth
+// opens; the last open one closes once it is empty and the others alone would
+// clear the backlog within toll_scale_down, the gap between the two being the
+// hysteresis. Booth state is read atomically; opening a booth locks the two
+// booths involved and closing one locks it, so vehicles being served never wait.
+// started[side] is a vehicle the new booth serves right away, or -1.
+void plaza_control(Simulation *sim, int started[2]) {
+    int64_t now = sim_now(sim);
+    for (int side = 0; side < 2; side++) {
+        started[side] = -1;
+        TollBooth *b = &sim->booths[side * sim->config.toll_per_side];
+        int open = sim->toll_open[side];
+        long load = 0, served = 0;
+        int64_t busy = 0;
+        int longest = 0;
+        for (int k = 0; k < sim->config.toll_per_side; k++) {
+            int at_booth = __atomic_load_n(&b[k].load, __ATOMIC_RELAXED);
+            load += at_booth;
+            if (k < open && at_booth > __atomic_load_n(&b[longest].load, __ATOMIC_RELAXED)) longest = k;
+            served += __atomic_load_n(&b[k].served, __ATOMIC_RELAXED);
+            busy += __atomic_load_n(&b[k].busy_ns, __ATOMIC_RELAXED);
+        }
+        double mean = served && busy ? busy / 1e9 / served : dist_mean(&sim->config.toll_service);
+        if (open < sim->config.toll_per_side && load * mean / open > sim->config.toll_scale_up) {
+            int first = side * sim->config.toll_per_side;
+            started[side] = booth_split(sim, first + longest, first + open);
+            __atomic_store_n(&sim->toll_open[side], open + 1, __ATOMIC_RELAXED);
+        } else if (open > sim->config.toll_min_open && __atomic_load_n(&b[open - 1].load, __ATOMIC_RELAXED) == 0 &&
+                   load * mean / (open - 1) < sim->config.toll_scale_down) {
+            // A vehicle that picked the booth just before it closed is still served
+            // there, and the booth stays staffed until it leaves
+            __atomic_store_n(&sim->toll_open[side], open - 1, __ATOMIC_RELAXED);
+            TollBooth *closed = &b[open - 1];
+            if (!sim->config.event_mode) pthread_mutex_lock(&closed->mutex);
+            if (closed->load == 0) booth_unstaff(closed, now);
+            else closed->closing = 1;
+            if (!sim->config.event_mode) pthread_mutex_unlock(&closed->mutex);
+        }
+    }
+}
+
+// Staffed time of a booth so far
+int64_t booth_open_ns(Simulation *sim, TollBooth *b) {
+    if (!sim->config.event_mode) pthread_mutex_lock(&b->mutex);
+    int64_t ns = b->open_ns + (b->opened_at >= 0 ? sim_now(sim) - b->opened_at : 0);
+    if (!sim->config.event_mode) pthread_mutex_unlock(&b->mutex);
+    return ns;
+}
+
+// Total staffed time of every booth, in hours
+double booth_hours(Simulation *sim) {
+    int64_t ns = 0;
+    for (int k = 0; k < 2 * sim->config.toll_per_side; k++) ns += booth_open_ns(sim, &sim->booths[k]);
+    return ns / 3.6e12;
+}
+
+// Put a vehicle at the back of its class's queue in its side's square. Caller holds boarding_mutex.
+void join_square(Simulation *sim, int i) {
+    Vehicle *v = &sim->vehicles[i];
+    int *head = &sim->gate_head[v->port][v->type], *tail = &sim->gate_tail[v->port][v->type];
+    v->state = V_WAITING;
+    v->next = -1;
+    v->square_seq = sim->square_seq++;
+    if (*tail < 0) *head = i;
+    else sim->vehicles[*tail].next = i;
+    *tail = i;
+    reach_add(&sim->gate_reach[v->port], v->type);
+    trace_event(sim, NULL, TR_SQUARE, i, v->port, 0);
+}
+
+void board_vehicle(Simulation *sim, Ferry *f, int i) {
+    Vehicle *v = &sim->vehicles[i];
+    VehicleRecord *rec = &sim->records[i];
+    if (v->port == SIDE_A) {
+        rec->wait_end_a = sim_now(sim);
+        record_vehicle_time(sim, v, LAT_WAIT, SIDE_A, rec->wait_end_a - rec->wait_start_a);
+        rec->ferry_start_a = sim_now(sim);
+        rec->a_trip_no = f->trip_id;
+    } else {
+        rec->wait_end_b = sim_now(sim);
+        record_vehicle_time(sim, v, LAT_WAIT, SIDE_B, rec->wait_end_b - rec->wait_start_b);
+        rec->ferry_start_b = sim_now(sim);
+        rec->b_trip_no = f->trip_id;
+    }
+    f->load += v->capacity;
+    v->boarded++;
+    v->state = V_ON_FERRY;
+    f->boarded_ids[f->boarded_count++] = v->id;
+    reach_remove(&sim->side_reach[v->port], v->type);
+    reach_remove(&sim->gate_reach[v->port], v->type);
+    trace_event(sim, f, TR_BOARD, v->id - 1, v->port, 0);
+    if (!sim->config.event_mode) {
+        LOCK_MUTEX(sim, LK_PRINT, &print_mutex);
+        printf("✅ %s %d boarded %s at Side-%c (Capacity: %d)\n", get_type_name(sim, v->type) + 7, v->id,
+               sim->ferry_count > 1 ? f->spec.name : "ferry", v->port == SIDE_A ? 'A' : 'B', f->load);
+        UNLOCK_MUTEX(sim, LK_PRINT, &print_mutex);
+    }
+}
+
+// Class whose queue head, of those in the eligible mask, joined the square
+// first; -1 if none. Merging the class queues this way walks the square in
+// joining order.
+int square_earliest(Simulation *sim, const int head[], unsigned eligible) {
+    int best = -1;
+    for (int c = 0; c < sim->config.class_count; c++)
+        if ((eligible >> c & 1) && head[c] >= 0 &&
+            (best < 0 || sim->vehicles[head[c]].square_seq < sim->vehicles[head[best]].square_seq))
+            best = c;
+    return best;
+}
+
+// Longest wait first, then joining order
+int plan_candidate_order(const void *a, const void *b) {
+    const PlanCandidate *x = a, *y = b;
+    if (x->waited != y->waited) return x->waited < y->waited ? 1 : -1;
+    return x->square_seq < y->square_seq ? -1 : x->square_seq > y->square_seq;
+}
+
+int plan_square_order(const void *a, const void *b) {
+    const PlanCandidate *x = a, *y = b;
+    return x->square_seq < y->square_seq ? -1 : x->square_seq > y->square_seq;
+}
+
+// One class's pass of the load planner, over the loads residue, residue + cap,
+// ... as rows 0..rows-1: best[t] is the largest prev[t - n] + prefix[n]. prefix
+// is concave (candidates come longest wait first), which makes the best source
+// row monotone in t, so divide and conquer finds every row's in O(rows log rows).
+// Outside 0 <= n <= count and on unreachable rows the value drops by penalty per
+// step instead of to -inf, which keeps it concave; any result below 0 is
+// unreachable.
+typedef struct {
+    const double *prev, *prefix;
+    double *best;
+    int *take;
+    int residue, cap, count;
+    double penalty;
+} PlanPass;
+
+double plan_value(const PlanPass *p, int t, int k) {
+    int n = t - k;
+    double from = p->prev[p->residue + k * p->cap];
+    if (from < 0) from = -p->penalty;
+    if (n < 0) return from + n * p->penalty;
+    if (n > p->count) return from + p->prefix[p->count] - (n - p->count) * p->penalty;
+    return from + p->prefix[n];
+}
+
+void plan_rows(const PlanPass *p, int lo, int hi, int opt_lo, int opt_hi) {
+    if (lo > hi) return;
+    int t = (lo + hi) / 2, opt = opt_lo;
+    double best = plan_value(p, t, opt_lo);
+    for (int k = opt_lo + 1; k <= opt_hi; k++) {
+        double value = plan_value(p, t, k);
+        if (value > best) {
+            best = value;
+            opt = k;
+        }
+    }
+    int j = p->residue + t * p->cap;
+    p->best[j] = best < 0 ? -1 : best;
+    p->take[j] = best < 0 ? 0 : t - opt;
+    plan_rows(p, lo, t - 1, opt_lo, opt);
+    plan_rows(p, t + 1, hi, opt, opt_hi);
+}
+
+// Load planner: a bounded knapsack over the vehicle classes in the square. It
+// picks the largest load that fits and, among equal loads, the one whose
+// vehicles have waited longest in total. Within a class the longest waiters
+// always go first, so only a count per class is chosen, and only the first
+// room / capacity vehicles of each class queue are candidates. Each class's
+// pass is O(capacity * log capacity) however full the square is, see
+// plan_rows. Boards the chosen vehicles and returns the load plain
+// first-come-first-served boarding would have reached. The tables are sized
+// for the largest vessel. Caller holds boarding_mutex.
+int board_planned_load(Simulation *sim, Ferry *f) {
+    int stride = sim->config.ferry_capacity + 1;
+    double *plan_wait = sim->planner_wait, *prev_wait = sim->planner_wait + stride;
+    PlanCandidate *pick = sim->planner_pick;
+    int classes = sim->config.class_count, waiting[MAX_VEHICLE_CLASSES] = {0};
+    int side = f->side, room = f->spec.capacity - f->load, fcfs_load = 0;
+    int64_t now = sim_now(sim);
+
+    for (int c = 0; c < classes; c++) {
+        int cap = sim->config.classes[c].capacity;
+        PlanCandidate *cand = pick + c * stride;
+        for (int i = sim->gate_head[side][c]; i >= 0 && (waiting[c] + 1) * cap <= room; i = sim->vehicles[i].next) {
+            VehicleRecord *rec = &sim->records[i];
+            cand[waiting[c]++] = (PlanCandidate){
+                .waited = ns_to_seconds(now - (side == SIDE_A ? rec->wait_start_a : rec->wait_start_b)),
+                .square_seq = sim->vehicles[i].square_seq, .vehicle = i};
+        }
+        qsort(cand, waiting[c], sizeof(PlanCandidate), plan_candidate_order);
+    }
+
+    // First come, first served takes every vehicle that still fits in joining
+    // order. Once a class doesn't fit it never will again, so it drops out.
+    int head[MAX_VEHICLE_CLASSES];
+    unsigned fits = (1u << classes) - 1;
+    memcpy(head, sim->gate_head[side], sizeof(head));
+    for (int c; (c = square_earliest(sim, head, fits)) >= 0;) {
+        if (fcfs_load + sim->config.classes[c].capacity <= room) {
+            fcfs_load += sim->config.classes[c].capacity;
+            head[c] = sim->vehicles[head[c]].next;
+        } else {
+            fits &= ~(1u << c);
+        }
+    }
+
+    for (int j = 0; j <= room; j++) plan_wait[j] = -1;
+    plan_wait[0] = 0;
+    for (int c = 0; c < classes; c++) {
+        double *prefix = sim->planner_prefix + c * stride;
+        PlanPass pass = {.prev = prev_wait, .prefix = prefix, .best = plan_wait, .take = sim->planner_take + c * stride,
+                         .cap = sim->config.classes[c].capacity, .count = waiting[c], .penalty = 1};
+        prefix[0] = 0;
+        for (int n = 0; n < waiting[c]; n++) prefix[n + 1] = prefix[n] + pick[c * stride + n].waited;
+        memcpy(prev_wait, plan_wait, sizeof(double) * (room + 1));
+        for (int j = 0; j <= room; j++)
+            if (prev_wait[j] + 1 > pass.penalty) pass.penalty = prev_wait[j] + 1;
+        pass.penalty += prefix[waiting[c]];
+        for (pass.residue = 0; pass.residue < pass.cap && pass.residue <= room; pass.residue++) {
+            int rows = (room - pass.residue) / pass.cap + 1;
+            plan_rows(&pass, 0, rows - 1, 0, rows - 1);
+        }
+    }
+
+    int load = room;
+    while (plan_wait[load] < 0) load--;
+    int take[MAX_VEHICLE_CLASSES];
+    for (int c = classes - 1, j = load; c >= 0; c--) {
+        take[c] = sim->planner_take[c * stride + j];
+        j -= take[c] * sim->config.classes[c].capacity;
+    }
+
+    // Take the chosen longest waiters out of their class queues, which are in
+    // joining order, then board them all in the order they joined
+    unsigned boarding = 0;
+    int next[MAX_VEHICLE_CLASSES] = {0};
+    for (int c = 0; c < classes; c++) {
+        if (!take[c]) continue;
+        PlanCandidate *cand = pick + c * stride;
+        qsort(cand, take[c], sizeof(PlanCandidate), plan_square_order);
+        for (int i = sim->gate_head[side][c], prev = -1, k = 0; k < take[c]; i = sim->vehicles[i].next) {
+            if (i != cand[k].vehicle) {
+                prev = i;
+                continue;
+            }
+            k++;
+            if (prev < 0) sim->gate_head[side][c] = sim->vehicles[i].next;
+            else sim->vehicles[prev].next = sim->vehicles[i].next;
+            if (sim->gate_tail[side][c] == i) sim->gate_tail[side][c] = prev;
+        }
+        boarding |= 1u << c;
+    }
+    while (boarding) {
+        int best = -1;
+        for (int c = 0; c < classes; c++)
+            if ((boarding >> c & 1) && (best < 0 || pick[c * stride + next[c]].square_seq <
+                                                        pick[best * stride + next[best]].square_seq))
+                best = c;
+        board_vehicle(sim, f, pick[best * stride + next[best]].vehicle);
+        if (++next[best] == take[best]) boarding &= ~(1u << best);
+    }
+    return fcfs_load;
+}
+
+// A vehicle's crossing ends at side. One that still has to cross back rests
+// there before it heads for the tolls. Caller holds boarding_mutex.
+void land_vehicle(Simulation *sim, int i, int side) {
+    Vehicle *v = &sim->vehicles[i];
+    if (side == SIDE_B) sim->records[i].ferry_end_a = sim_now(sim);
+    else sim->records[i].ferry_end_b = sim_now(sim);
+    if (v->boarded == 2) return;
+    v->ready_time = clock_seconds(sim) + sim->records[i].wait_duration_b;
+    reach_add(&sim->side_reach[side], v->type);
+    heap_push(&sim->resting[side], &sim->resting_count[side], &sim->resting_size[side], (Event){v->ready_time, 0, i, 0});
+}
+
+// A vehicle at side still has to cross once it is out of its rest
+// time. side_reach counts everyone still to board there; vehicles leave the
+// resting heap once their rest is over, so this is O(classes) amortized
+// whatever the fleet size. Caller holds boarding_mutex.
+int vehicles_waiting_at_ferry(Simulation *sim, int side) {
+    int pending = 0;
+    double now = clock_seconds(sim);
+    Event rested;
+    while (sim->resting_count[side] && sim->resting[side][0].time <= now)
+        heap_pop(sim->resting[side], &sim->resting_count[side], &rested);
+    for (int c = 0; c < sim->config.class_count; c++) pending += sim->side_reach[side].count[c];
+    return pending > sim->resting_count[side];
+}
+
+// Departure policy shared by both modes. Caller holds boarding_mutex.
+int ferry_should_depart(Simulation *sim, Ferry *f, int checks) {
+    int room = f->spec.capacity - f->load;
+    int planned = best_fill(&sim->gate_reach[f->side], room);
+    if (sim->config.departure_policy == DEPART_FULL)
+        return planned == room || checks >= sim->config.max_ferry_checks;
+    // Nobody still on the way to the square could raise the planned load
+    int no_gain = best_fill(&sim->side_reach[f->side], room) == planned;
+    return planned == room || no_gain || !vehicles_waiting_at_ferry(sim, f->side) || checks >= sim->config.max_ferry_checks;
+}
+
+// f has reached its side: take a free berth there, or queue behind the vessels
+// already waiting for one. Returns 1 once docked. Caller holds boarding_mutex.
+int request_berth(Simulation *sim, Ferry *f) {
+    int side = f->side;
+    if (sim->berths_free[side] > 0) {
+        sim->berths_free[side]--;
+        f->state = FERRY_DOCKED;
+        return 1;
+    }
+    f->state = FERRY_WAITING;
+    f->queued_at = sim_now(sim);
+    f->next = -1;
+    if (sim->berth_tail[side] < 0) sim->berth_head[side] = f - sim->ferries;
+    else sim->ferries[sim->berth_tail[side]].next = f - sim->ferries;
+    sim->berth_tail[side] = f - sim->ferries;
+    return 0;
+}
+
+// f casts off. Its berth goes straight to the first vessel waiting at that
+// side, which is returned so the caller can let it unload; NULL if nobody was
+// waiting. Caller holds boarding_mutex.
+Ferry *release_berth(Simulation *sim, Ferry *f) {
+    int side = f->side, k = sim->berth_head[side];
+    f->state = FERRY_CROSSING;
+    if (k < 0) {
+        sim->berths_free[side]++;
+        return NULL;
+    }
+    Ferry *next = &sim->ferries[k];
+    sim->berth_head[side] = next->next;
+    if (sim->berth_head[side] < 0) sim->berth_tail[side] = -1;
+    next->state = FERRY_DOCKED;
+    next->berth_wait_ns += sim_now(sim) - next->queued_at;
+    return next;
+}
+
+// Every vessel starts out arriving at Side-A, and they queue for its berths in fleet order
+void queue_fleet(Simulation *sim) {
+    for (int k = 0; k < sim->ferry_count; k++) {
+        trace_event(sim, &sim->ferries[k], TR_ARRIVE, -1, SIDE_A, 0);
+        request_berth(sim, &sim->ferries[k]);
+    }
+}
+
+// Seqlock writer. Only ferry threads publish, with boarding_mutex held, which
+// keeps them from overlapping, and at most every SNAPSHOT_INTERVAL seconds
+// unless forced. The payload goes word by word through release stores and
+// acquire loads rather than memcpy between fences, so the racing reads are
+// defined and ThreadSanitizer can follow them; on x86 both are plain moves.
+void publish_snapshot(Simulation *sim, int force) {
+    double now = clock_seconds(sim);
+    if (sim->config.event_mode || (!force && now - sim->snapshot_time < SNAPSHOT_INTERVAL)) return;
+    sim->snapshot_time = now;
+
+    StateSnapshot snap = {
+        .elapsed = sim_now(sim) / 1000000000,
+        .trip_id = sim->current_trip_id,
+        .returned = __atomic_load_n(&sim->total_returned, __ATOMIC_RELAXED),
+    };
+    for (int side = 0; side < 2; side++)
+        memcpy(snap.waiting[side], sim->side_reach[side].count, sizeof(snap.waiting[side]));
+    for (int k = 0; k < sim->ferry_count; k++) {
+        Ferry *f = &sim->ferries[k];
+        snap.ferry_side[k] = f->side;
+        snap.ferry_state[k] = f->state;
+        snap.ferry_load[k] = f->load;
+        snap.load += f->load;
+        for (int i = 0; i < f->boarded_count; i++) snap.on_board[vehicle_by_id(sim, f->boarded_ids[i])->type]++;
+    }
+
+    unsigned seq = sim->snapshot_seq;
+    uint64_t words[SNAPSHOT_WORDS] = {0};
+    memcpy(words, &snap, sizeof(snap));
+    __atomic_store_n(&sim->snapshot_seq, seq + 1, __ATOMIC_RELAXED);
+    // Each release store keeps the odd sequence number ahead of it
+    for (size_t k = 0; k < SNAPSHOT_WORDS; k++) __atomic_store_n(&sim->snapshot[k], words[k], __ATOMIC_RELEASE);
+    __atomic_store_n(&sim->snapshot_seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+// Seqlock reader: retry until a copy was taken with no publish in between
+void read_snapshot(Simulation *sim, StateSnapshot *snap) {
+    unsigned before, after;
+    uint64_t words[SNAPSHOT_WORDS];
+    do {
+        before = __atomic_load_n(&sim->snapshot_seq, __ATOMIC_ACQUIRE);
+        // Acquire loads keep the second read of the sequence number behind the payload
+        for (size_t k = 0; k < SNAPSHOT_WORDS; k++) words[k] = __atomic_load_n(&sim->snapshot[k], __ATOMIC_ACQUIRE);
+        after = __atomic_load_n(&sim->snapshot_seq, __ATOMIC_RELAXED);
+    } while (before != after || (before & 1));
+    memcpy(snap, words, sizeof(*snap));
+}
+
+// One row of per-class counts
+void print_class_counts(Simulation *sim, FILE *out, const char *label, const char *mark, const int *counts) {
+    fprintf(out, "┃ %s: ", label);
+    int shown = 0;
+    for (int c = 0; c < sim->config.class_count; c++) {
+        if (!counts[c]) continue;
+        fprintf(out, "%s%s ×%d  ", mark, get_type_name(sim, c), counts[c]);
+        shown++;
+    }
+    if (!shown) fprintf(out, "-");
+    fprintf(out, "\n");
+}
+
+// Where vessel k is, as the console shows it
+const char *ferry_status(const StateSnapshot *snap, int k) {
+    int a = snap->ferry_side[k] == SIDE_A;
+    switch (snap->ferry_state[k]) {
+        case FERRY_CROSSING: return a ? "\033[32m→→→ A→B\033[0m" : "\033[32m←←← B→A\033[0m";
+        case FERRY_WAITING: return a ? "\033[33mwaiting at A\033[0m" : "\033[33mwaiting at B\033[0m";
+        default: return a ? "\033[32mdocked at A\033[0m" : "\033[32mdocked at B\033[0m";
+    }
+}
+
+// One console frame for a snapshot
+void render_state(Simulation *sim, const StateSnapshot *snap, int wait_counter, FILE *out) {
+    int fleet_capacity = 0;
+    for (int k = 0; k < sim->ferry_count; k++) fleet_capacity += sim->ferries[k].spec.capacity;
+    fprintf(out, "\033[H\033[J"); // Clear screen
+    fprintf(out, "\033[1m┏━━━━━━━━━━━━━━━━━━━━━━━━━ Ferry Simulation ━━━━━━━━━━━━━━━━━━━━━━━━┓\n");
+    fprintf(out, "┃ Progress: %3.1f%% | Time Elapsed: %ld s | Trip: %d \033[0m┃\n",
+            (snap->returned / (float)sim->total_vehicles) * 100, snap->elapsed, snap->trip_id);
+    fprintf(out, "┣━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━┫\n");
+    if (sim->ferry_count == 1) {
+        fprintf(out, "┃ \033[31m🅰 Side-A\033[0m      \033[36m⛴️ Ferry (%s)\033[0m      \033[31mSide-B 🅱\033[0m ┃\n",
+                ferry_status(snap, 0));
+    } else {
+        fprintf(out, "┃ \033[31m🅰 Side-A\033[0m      \033[36m⛴️ Fleet of %d\033[0m      \033[31mSide-B 🅱\033[0m ┃\n",
+                sim->ferry_count);
+        for (int k = 0; k < sim->ferry_count; k++)
+            fprintf(out, "┃ \033[36m%-15s\033[0m %s | Load: %2d/%-2d\n", sim->ferries[k].spec.name, ferry_status(snap, k),
+                    snap->ferry_load[k], sim->ferries[k].spec.capacity);
+    }
+    fprintf(out, "┣━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━┫\n");
+    print_class_counts(sim, out, "Side-A", "⏳", snap->waiting[SIDE_A]);
+    print_class_counts(sim, out, "Ferry ", "🚢", snap->on_board);
+    print_class_counts(sim, out, "Side-B", "⏳", snap->waiting[SIDE_B]);
+    fprintf(out, "┣━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━┫\n");
+    fprintf(out, "┃ Returned: %2d/%-2d | Load: %2d/%-2d | Wait: %.1fs | Time: %3ld \033[0m┃\n",
+            snap->returned, sim->total_vehicles, snap->load, fleet_capacity,
+            wait_counter * 0.25, time(NULL) % 1000);
+    fprintf(out, "\033[1m┗━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━┛\n\033[0m");
+}
+
+// Draws the latest snapshot. The frame is built off to the side and written
+// with a single fwrite, which stdio keeps whole against the vehicles' own
+// lines, so the renderer holds no simulation lock, not even print_mutex.
+void print_state(Simulation *sim, int wait_counter) {
+    StateSnapshot snap;
+    read_snapshot(sim, &snap);
+    char *frame = NULL;
+    size_t frame_size = 0;
+    FILE *out = open_memstream(&frame, &frame_size);
+    if (!out) return;
+    render_state(sim, &snap, wait_counter, out);
+    fclose(out);
+
+    fwrite(frame, 1, frame_size, stdout);
+    fflush(stdout);
+    free(frame);
+}
+void print_latency_row(FILE *out, const char *left, const char *right, const char *metric, const char *class_name,
+                       const char *side, const LatencyHistogram *h) {
+    fprintf(out, "%s%-10s | %-9s | %-4s | %7ld | %7.2fs | %7.2fs | %7.2fs | %7.2fs | %7.2fs%s\n", left, metric,
+            class_name, side, h->count, hist_percentile(h, 0.5), hist_percentile(h, 0.9), hist_percentile(h, 0.99),
+            hist_percentile(h, 0.999), h->max / 1e9, right);
+}
+
+// Tail latencies: waits per class and side, crossings per side, round trips per class.
+// Each row is framed by left and right so the console can draw its box around them.
+void print_latency_table(Simulation *sim, FILE *out, const char *left, const char *right) {
+    fprintf(out, "%sMetric     | Class     | Side |   Count |      p50 |      p90 |      p99 |    p99.9 |      Max%s\n",
+            left, right);
+    for (int c = 0; c < sim->config.class_count; c++)
+        for (int side = 0; side < 2; side++) {
+            LatencyHistogram *h = latency_hist(sim, sim->latency, LAT_WAIT, c, side);
+            if (h->count) print_latency_row(out, left, right, "Wait", get_class_name(sim, c), side == SIDE_A ? "A" : "B", h);
+        }
+    for (int side = 0; side < 2; side++) {
+        LatencyHistogram crossing = {0};
+        for (int c = 0; c < sim->config.class_count; c++)
+            hist_merge(&crossing, latency_hist(sim, sim->latency, LAT_CROSSING, c, side));
+        if (crossing.count) print_latency_row(out, left, right, "Crossing", "all", side == SIDE_A ? "A->B" : "B->A", &crossing);
+    }
+    for (int c = 0; c < sim->config.class_count; c++) {
+        LatencyHistogram round_trip = *latency_hist(sim, sim->latency, LAT_ROUND_TRIP, c, SIDE_A);
+        hist_merge(&round_trip, latency_hist(sim, sim->latency, LAT_ROUND_TRIP, c, SIDE_B));
+        if (round_trip.count) print_latency_row(out, left, right, "Round Trip", get_class_name(sim, c), "", &round_trip);
+    }
+}
+
+// Toll plaza: per booth, the share of the run it was open, vehicles served,
+// the share of the run spent serving, and the time-averaged and longest queue
+// behind it; then the staffing cost in booth-hours
+void print_toll_table(Simulation *sim, FILE *out, const char *left, const char *right) {
+    double duration = clock_seconds(sim);
+    fprintf(out, "%sBooth | Side |   Open | Served | Utilization | Avg Queue | Max Queue%s\n", left, right);
+    for (int k = 0; k < 2 * sim->config.toll_per_side; k++) {
+        TollBooth *b = &sim->booths[k];
+        fprintf(out, "%s%5d | %-4c | %5.1f%% | %6ld | %10.2f%% | %9.3f | %9d%s\n", left, k % sim->config.toll_per_side + 1,
+                k < sim->config.toll_per_side ? 'A' : 'B', duration > 0 ? booth_open_ns(sim, b) / 1e7 / duration : 0,
+                b->served, duration > 0 ? b->busy_ns / 1e7 / duration : 0,
+                duration > 0 ? b->queue_ns / 1e9 / duration : 0, b->max_queue, right);
+    }
+    fprintf(out, "%sStaffing: %.4f booth-hours, %.2f booths open on average%s\n", left, booth_hours(sim),
+            duration > 0 ? booth_hours(sim) * 3600 / duration : 0, right);
+}
+
+// Per vessel: trips, empty trips, units carried, utilization against its own
+// capacity, mean crossing and the time spent waiting for a berth; then the
+// same over the whole fleet
+void print_fleet_table(Simulation *sim, FILE *out, const char *left, const char *right) {
+    // Index ferry_count holds the fleet totals
+    long trips[MAX_FERRIES + 1] = {0}, empty[MAX_FERRIES + 1] = {0};
+    double units[MAX_FERRIES + 1] = {0}, room[MAX_FERRIES + 1] = {0}, crossing[MAX_FERRIES + 1] = {0};
+    int64_t berth_wait[MAX_FERRIES + 1] = {0};
+    int fleet = sim->ferry_count;
+    for (int i = 0; i < sim->trip_count; i++) {
+        Trip *t = &sim->trip_log[i];
+        int rows[2] = {t->ferry, fleet};
+        for (int r = 0; r < 2; r++) {
+            trips[rows[r]]++;
+            empty[rows[r]] += t->vehicle_count == 0;
+            units[rows[r]] += t->capacity_used;
+            room[rows[r]] += trip_capacity(sim, t);
+            crossing[rows[r]] += t->duration;
+        }
+    }
+    for (int k = 0; k < fleet; k++) {
+        berth_wait[k] = sim->ferries[k].berth_wait_ns;
+        berth_wait[fleet] += berth_wait[k];
+    }
+
+    fprintf(out, "%sVessel          | Capacity | Speed | Trips | Empty |  Units | Utilization | Avg Crossing | Berth Wait%s\n",
+            left, right);
+    int capacity = 0;
+    for (int k = 0; k <= fleet; k++) {
+        if (k == fleet && fleet == 1) break; // The lone vessel is the fleet
+        VesselSpec *spec = k < fleet ? &sim->ferries[k].spec : NULL;
+        capacity += spec ? spec->capacity : 0;
+        fprintf(out, "%s%-15s | %8d | ", left, spec ? spec->name : "Fleet", spec ? spec->capacity : capacity);
+        if (spec) fprintf(out, "%5.2f | ", spec->speed);
+        else fprintf(out, "%5s | ", "-");
+        fprintf(out, "%5ld | %5ld | %6.0f | %10.2f%% | %11.2fs | %9.2fs%s\n", trips[k], empty[k], units[k],
+                room[k] > 0 ? units[k] / room[k] * 100 : 0, trips[k] ? crossing[k] / trips[k] : 0, berth_wait[k] / 1e9, right);
+    }
+}
+
+void write_log_file(Simulation *sim) {
+    FILE *fp = fopen("ferry_log.txt", "w");
+    if (!fp) return;
+
+    fprintf(fp, "=== Ferry Simulation Log ===\n");
+    fprintf(fp, "Total Vehicles: %d | Ferry Capacity: %d | Total Trips: %d\n", sim->total_vehicles, sim->config.ferry_capacity, sim->trip_count);
+    fprintf(fp, "Simulation Duration: %.3f seconds\n\n", clock_seconds(sim));
+
+    fprintf(fp, "=== Trip Summary ===\n");
+    for (int i = 0; i < sim->trip_count; i++) {
+        Trip *t = &sim->trip_log[i];
+        char vessel[32];
+        fprintf(fp, "Trip %d [%s%s]: %.2fs | Capacity: %d/%d (%.1f%%) | FCFS: %d | Vehicles: ",
+                t->trip_id, t->direction == SIDE_A ? "A->B" : "B->A", trip_vessel(sim, t, vessel), t->duration,
+                t->capacity_used, trip_capacity(sim, t), (t->capacity_used / (float)trip_capacity(sim, t)) * 100,
+                t->fcfs_capacity);
+        int *ids = trip_vehicle_ids(sim, t);
+        for (int j = 0; j < t->vehicle_count; j++)
+            fprintf(fp, "%s%d ", get_type_name(sim, vehicle_by_id(sim, ids[j])->type) + 7, ids[j]);
+        fprintf(fp, "\n");
+    }
+
+    fprintf(fp, "\n=== Latency Percentiles ===\n");
+    print_latency_table(sim, fp, "", "");
+
+    fprintf(fp, "\n=== Toll Booths ===\n");
+    print_toll_table(sim, fp, "", "");
+
+    fprintf(fp, "\n=== Fleet ===\n");
+    print_fleet_table(sim, fp, "", "");
+
+    if (sim->config.vehicle_table) {
+        fprintf(fp, "\n=== Vehicle Statistics ===\n");
+        fprintf(fp, "ID | Type      | Start | Wait A | Wait B | Ferry A | Ferry B | Round Trip\n");
+    }
+    for (int i = 0; sim->config.vehicle_table && i < sim->total_vehicles; i++) {
+        fprintf(fp, "%2d | %-9s | %-5c | %6.3fs | %6.3fs | %7.3fs | %7.3fs | %8.3fs\n",
+                sim->vehicles[i].id, get_type_name(sim, sim->vehicles[i].type) + 7,
+                sim->records[i].start_port == SIDE_A ? 'A' : 'B',
+                sim->wait_time_a[i], sim->wait_time_b[i], sim->ferry_time_a[i], sim->ferry_time_b[i], sim->round_trip_time[i]);
+    }
+
+    fclose(fp);
+}
+
+// Streaming JSON writer: values go straight into a small buffer that
+// is flushed to the file descriptor when full, so no document tree is built and
+// memory stays constant whatever the log size
+typedef struct {
+    int fd;
+    int len;
+    int depth;
+    unsigned first; // Bit d set: nothing written yet at nesting depth d
+    char buf[8192];
+} JsonWriter;
+
+void json_flush(JsonWriter *w) {
+    for (int off = 0; off < w->len; ) {
+        ssize_t n = write(w->fd, w->buf + off, w->len - off);
+        if (n <= 0) break;
+        off += n;
+    }
+    w->len = 0;
+}
+
+void json_put(JsonWriter *w, const char *s, int n) {
+    while (n > 0) {
+        if (w->len == (int)sizeof(w->buf)) json_flush(w);
+        int chunk = (int)sizeof(w->buf) - w->len;
+        if (chunk > n) chunk = n;
+        memcpy(w->buf + w->len, s, chunk);
+        w->len += chunk;
+        s += chunk;
+        n -= chunk;
+    }
+}
+
+void json_put_string(JsonWriter *w, const char *s) {
+    json_put(w, "\"", 1);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') {
+            char esc[2] = {'\\', *s};
+            json_put(w, esc, 2);
+        } else if ((unsigned char)*s < 0x20) {
+            char esc[8];
+            json_put(w, esc, sprintf(esc, "\\u%04x", *s));
+        } else {
+            json_put(w, s, 1);
+        }
+    }
+    json_put(w, "\"", 1);
+}
+
+// Separator and key for the next value; key is NULL inside arrays
+void json_key(JsonWriter *w, const char *key) {
+    if (!(w->first & (1u << w->depth))) json_put(w, ",", 1);
+    w->first &= ~(1u << w->depth);
+    if (key) {
+        json_put_string(w, key);
+        json_put(w, ":", 1);
+    }
+}
+
+void json_number(JsonWriter *w, const char *key, double num) {
+    char tmp[32];
+    json_key(w, key);
+    json_put(w, tmp, sprintf(tmp, "%.2f", num));
+}
+
+// Counts, ids and units
+void json_int(JsonWriter *w, const char *key, long num) {
+    char tmp[32];
+    json_key(w, key);
+    json_put(w, tmp, sprintf(tmp, "%ld", num));
+}
+
+// Latencies, to the nanosecond they were measured in
+void json_seconds(JsonWriter *w, const char *key, double seconds) {
+    char tmp[32];
+    json_key(w, key);
+    json_put(w, tmp, sprintf(tmp, "%.9f", seconds));
+}
+
+void json_string(JsonWriter *w, const char *key, const char *value) {
+    json_key(w, key);
+    json_put_string(w, value);
+}
+
+// open is '{' or '['
+void json_begin(JsonWriter *w, const char *key, char open) {
+    json_key(w, key);
+    json_put(w, &open, 1);
+    w->depth++;
+    w->first |= 1u << w->depth;
+}
 
-typedef struct {
-    int trip_id;
-    int direction; // 0: A->B, 1: B->A
-    double duration;
-    int vehicle_ids[20];
-    int vehicle_count;
-    int capacity_used;
-} Trip;
+void json_end(JsonWriter *w, char close) {
+    w->depth--;
+    json_put(w, &close, 1);
+}
 
-// Global variables
-Vehicle vehicles[TOTAL_VEHICLES];
-Trip trip_log[MAX_TRIPS];
-int trip_count = 0;
-int ferry_capacity = 0;
-int ferry_side = SIDE_A;
-int total_returned = 0;
-int current_trip_id = 0;
-int is_first_return = 1;
-int final_trip_done = 0;
-int boarded_ids[20];
-int boarded_count = 0;
-double wait_time_a[TOTAL_VEHICLES], wait_time_b[TOTAL_VEHICLES];
-double ferry_time_a[TOTAL_VEHICLES], ferry_time_b[TOTAL_VEHICLES];
-double round_trip_time[TOTAL_VEHICLES];
-time_t sim_start_time;
-
-// Synchronization primitives
-pthread_mutex_t boarding_mutex = PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t return_mutex = PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t print_mutex = PTHREAD_MUTEX_INITIALIZER;
-sem_t toll_sem[4]; // 0-1: Side-A tolls, 2-3: Side-B tolls
+int json_open(JsonWriter *w, const char *path) {
+    w->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    w->len = 0;
+    w->depth = 0;
+    w->first = 1;
+    return w->fd < 0 ? -1 : 0;
+}
 
-// Helper functions
-const char* get_type_name(int type) {
-    switch (type) {
-        case 0: return "\033[32m🟢 Car\033[0m";
-        case 1: return "\033[34m🔵 Minibus\033[0m";
-        case 2: return "\033[33m🟡 Truck\033[0m";
-        default: return "Unknown";
-    }
+void json_close(JsonWriter *w) {
+    json_put(w, "\n", 1);
+    json_flush(w);
+    close(w->fd);
 }
 
-void log_trip(int direction, double duration, int *ids, int count, int capacity) {
-    pthread_mutex_lock(&log_mutex);
-    Trip *t = &trip_log[trip_count++];
-    t->trip_id = current_trip_id;
-    t->direction = direction;
-    t->duration = duration;
-    t->vehicle_count = count;
-    t->capacity_used = capacity;
-    memcpy(t->vehicle_ids, ids, sizeof(int) * count);
-    pthread_mutex_unlock(&log_mutex);
-}
-
-void print_state(int wait_counter) {
-    pthread_mutex_lock(&print_mutex);
-    printf("\033[H\033[J"); // Clear screen
-    printf("\033[1m┏━━━━━━━━━━━━━━━━━━━━━━━━━ Ferry Simulation ━━━━━━━━━━━━━━━━━━━━━━━━┓\n");
-    printf("┃ Progress: %3.1f%% | Time Elapsed: %ld s | Trip: %d/%d \033[0m┃\n",
-           (total_returned / (float)TOTAL_VEHICLES) * 100, time(NULL) - sim_start_time,
-           current_trip_id, MAX_TRIPS);
-    printf("┣━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━┫\n");
-    printf("┃ \033[31m🅰 Side-A\033[0m      \033[36m⛴️ Ferry (%s)\033[0m      \033[31mSide-B 🅱\033[0m ┃\n",
-           ferry_side == SIDE_A ? "\033[32m→→→ A→B\033[0m" : "\033[32m←←← B→A\033[0m");
-    printf("┣━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━┫\n");
-
-    // Side-A vehicles
-    printf("┃ Side-A: ");
-    int count_a = 0;
-    for (int i = 0; i < TOTAL_VEHICLES; i++) {
-        if (vehicles[i].port == SIDE_A && !vehicles[i].returned && vehicles[i].boarded < 2) {
-            printf("⏳%s%d ", get_type_name(vehicles[i].type), vehicles[i].id);
-            count_a++;
-        }
-    }
-    for (int i = count_a; i < 8; i++) printf("          ");
-    printf("┃\n");
-
-    // Ferry vehicles
-    printf("┃ Ferry : ");
-    for (int i = 0; i < boarded_count; i++) {
-        for (int j = 0; j < TOTAL_VEHICLES; j++) {
-            if (vehicles[j].id == boarded_ids[i]) {
-                printf("🚢%s%d ", get_type_name(vehicles[j].type), vehicles[j].id);
-                break;
-            }
+// Same schema as the V2 ferry_log.json
+void write_json_log(Simulation *sim) {
+    JsonWriter w;
+    if (json_open(&w, "ferry_log.json") < 0) return;
+
+    json_begin(&w, NULL, '{');
+    json_int(&w, "total_vehicles", sim->total_vehicles);
+    json_int(&w, "ferry_capacity", sim->config.ferry_capacity);
+    json_int(&w, "total_trips", sim->trip_count);
+    json_number(&w, "duration", clock_seconds(sim));
+    json_number(&w, "booth_hours", booth_hours(sim));
+
+    json_begin(&w, "trips", '[');
+    for (int i = 0; i < sim->trip_count; i++) {
+        Trip *t = &sim->trip_log[i];
+        json_begin(&w, NULL, '{');
+        json_int(&w, "id", t->trip_id);
+        json_string(&w, "direction", t->direction == SIDE_A ? "A->B" : "B->A");
+        json_string(&w, "ferry", sim->ferries[t->ferry].spec.name);
+        json_number(&w, "duration", t->duration);
+        json_int(&w, "capacity_used", t->capacity_used);
+        json_number(&w, "capacity_percent", (t->capacity_used / (float)trip_capacity(sim, t)) * 100);
+        json_int(&w, "fcfs_capacity", t->fcfs_capacity);
+        json_begin(&w, "vehicles", '[');
+        int *ids = trip_vehicle_ids(sim, t);
+        for (int j = 0; j < t->vehicle_count; j++) {
+            char buf[32];
+            sprintf(buf, "%s%d", get_class_name(sim, vehicle_by_id(sim, ids[j])->type), ids[j]);
+            json_string(&w, NULL, buf);
         }
+        json_end(&w, ']');
+        json_end(&w, '}');
     }
-    for (int i = boarded_count; i < 8; i++) printf("          ");
-    printf("┃\n");
+    json_end(&w, ']');
 
-    // Side-B vehicles
-    printf("┃ Side-B: ");
-    int count_b = 0;
-    for (int i = 0; i < TOTAL_VEHICLES; i++) {
-        if (vehicles[i].port == SIDE_B && !vehicles[i].returned && vehicles[i].boarded < 2) {
-            printf("⏳%s%d ", get_type_name(vehicles[i].type), vehicles[i].id);
-            count_b++;
-        }
+    static const char *metric_names[LAT_METRICS] = {"wait", "crossing", "total_wait", "round_trip"};
+    json_begin(&w, "latency", '[');
+    for (int m = 0; m < LAT_METRICS; m++)
+        for (int c = 0; c < sim->config.class_count; c++)
+            for (int side = 0; side < 2; side++) {
+                LatencyHistogram *h = latency_hist(sim, sim->latency, m, c, side);
+                if (!h->count) continue;
+                json_begin(&w, NULL, '{');
+                json_string(&w, "metric", metric_names[m]);
+                json_string(&w, "type", get_class_name(sim, c));
+                json_string(&w, "side", side == SIDE_A ? "A" : "B");
+                json_int(&w, "count", h->count);
+                json_seconds(&w, "mean", hist_mean(h));
+                json_seconds(&w, "p50", hist_percentile(h, 0.5));
+                json_seconds(&w, "p90", hist_percentile(h, 0.9));
+                json_seconds(&w, "p99", hist_percentile(h, 0.99));
+                json_seconds(&w, "p999", hist_percentile(h, 0.999));
+                json_seconds(&w, "max", h->max / 1e9);
+                json_end(&w, '}');
+            }
+    json_end(&w, ']');
+
+    json_begin(&w, "booths", '[');
+    for (int k = 0; k < 2 * sim->config.toll_per_side; k++) {
+        TollBooth *b = &sim->booths[k];
+        double duration = clock_seconds(sim);
+        json_begin(&w, NULL, '{');
+        json_int(&w, "booth", k % sim->config.toll_per_side + 1);
+        json_string(&w, "side", k < sim->config.toll_per_side ? "A" : "B");
+        json_number(&w, "open_share", duration > 0 ? booth_open_ns(sim, b) / 1e9 / duration : 0);
+        json_int(&w, "served", b->served);
+        json_number(&w, "utilization", duration > 0 ? b->busy_ns / 1e9 / duration : 0);
+        json_number(&w, "avg_queue", duration > 0 ? b->queue_ns / 1e9 / duration : 0);
+        json_int(&w, "max_queue", b->max_queue);
+        json_end(&w, '}');
     }
-    for (int i = count_b; i < 8; i++) printf("          ");
-    printf("┃\n");
+    json_end(&w, ']');
 
-    // Starting points
-    printf("┃ Start : ");
-    int count_s = 0;
-    for (int i = 0; i < TOTAL_VEHICLES; i++) {
-        if (!vehicles[i].returned && vehicles[i].boarded < 2) {
-            printf("%c%-9d ", vehicles[i].start_port == SIDE_A ? 'A' : 'B', vehicles[i].id);
-            count_s++;
+    json_begin(&w, "fleet", '[');
+    for (int k = 0; k < sim->ferry_count; k++) {
+        Ferry *f = &sim->ferries[k];
+        long trips = 0, empty = 0;
+        long units = 0;
+        for (int i = 0; i < sim->trip_count; i++) {
+            Trip *t = &sim->trip_log[i];
+            if (t->ferry != k) continue;
+            trips++;
+            empty += t->vehicle_count == 0;
+            units += t->capacity_used;
         }
+        json_begin(&w, NULL, '{');
+        json_string(&w, "name", f->spec.name);
+        json_int(&w, "capacity", f->spec.capacity);
+        json_number(&w, "speed", f->spec.speed);
+        json_int(&w, "trips", trips);
+        json_int(&w, "empty_trips", empty);
+        json_int(&w, "units", units);
+        json_number(&w, "utilization", trips ? units / (trips * (double)f->spec.capacity) : 0);
+        json_seconds(&w, "berth_wait", f->berth_wait_ns / 1e9);
+        json_end(&w, '}');
     }
-    for (int i = count_s; i < 8; i++) printf("          ");
-    printf("┃\n");
+    json_end(&w, ']');
 
-    printf("┣━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━┫\n");
-    printf("┃ Returned: %2d/%-2d | Load: %2d/%-2d | Wait: %.1fs | Time: %3ld \033[0m┃\n",
-           total_returned, TOTAL_VEHICLES, ferry_capacity, FERRY_CAPACITY,
-           wait_counter * 0.25, time(NULL) % 1000);
-    printf("\033[1m┗━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━┛\n\033[0m");
-    pthread_mutex_unlock(&print_mutex);
+    if (sim->config.vehicle_table) json_begin(&w, "vehicles", '[');
+    for (int i = 0; sim->config.vehicle_table && i < sim->total_vehicles; i++) {
+        json_begin(&w, NULL, '{');
+        json_int(&w, "id", sim->vehicles[i].id);
+        json_string(&w, "type", get_class_name(sim, sim->vehicles[i].type));
+        json_string(&w, "start", sim->records[i].start_port == SIDE_A ? "A" : "B");
+        json_seconds(&w, "wait_a", sim->wait_time_a[i]);
+        json_seconds(&w, "wait_b", sim->wait_time_b[i]);
+        json_seconds(&w, "ferry_a", sim->ferry_time_a[i]);
+        json_seconds(&w, "ferry_b", sim->ferry_time_b[i]);
+        json_seconds(&w, "round_trip", sim->round_trip_time[i]);
+        json_end(&w, '}');
+    }
+    if (sim->config.vehicle_table) json_end(&w, ']');
+    json_end(&w, '}');
+    json_close(&w);
 }
 
-void write_log_file() {
-    FILE *fp = fopen("ferry_log.txt", "w");
-    if (!fp) return;
-
-    fprintf(fp, "=== Ferry Simulation Log ===\n");
-    fprintf(fp, "Total Vehicles: %d | Ferry Capacity: %d | Total Trips: %d\n", TOTAL_VEHICLES, FERRY_CAPACITY, trip_count);
-    fprintf(fp, "Simulation Duration: %ld seconds\n\n", time(NULL) - sim_start_time);
+#ifdef LOCK_PROFILE
+// Contention report: per lock, how often it was taken and found busy, the time
+// threads spent blocked on it against the time it was held, and the call sites
+// that blocked the longest
+void print_lock_profile(Simulation *sim) {
+    static const char *names[LK_LOCKS] = {"boarding_mutex", "print_mutex", "return_mutex", "log_mutex"};
+    double run = clock_seconds(sim);
+    printf("\n\033[1m┏━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━ Lock Contention ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━┓\033[0m\n");
+    printf("┃ Lock           | Acquired | Contended | Blocked s | Held s (%% of run) | Wait p99 / max us | Hold p50 / p99 / max us\n");
+    for (int k = 0; k < LK_LOCKS; k++) {
+        LockProfile *p = &sim->lock_profile[k];
+        printf("┃ %-14s | %8ld | %8.2f%% | %9.4f | %7.3f (%6.2f%%) | %8.1f / %8.1f | %6.1f / %6.1f / %8.1f\n",
+               names[k], p->count, p->count ? 100.0 * p->contended / p->count : 0, p->wait.sum / 1e9,
+               p->hold.sum / 1e9, run > 0 ? p->hold.sum / 1e7 / run : 0,
+               hist_percentile(&p->wait, 0.99) * 1e6, p->wait.max / 1e3,
+               hist_percentile(&p->hold, 0.5) * 1e6, hist_percentile(&p->hold, 0.99) * 1e6, p->hold.max / 1e3);
 
-    fprintf(fp, "=== Trip Summary ===\n");
-    for (int i = 0; i < trip_count; i++) {
-        Trip *t = &trip_log[i];
-        fprintf(fp, "Trip %d [%s]: %.2fs | Capacity: %d/%d (%.1f%%) | Vehicles: ",
-                t->trip_id, t->direction == SIDE_A ? "A->B" : "B->A", t->duration,
-                t->capacity_used, FERRY_CAPACITY, (t->capacity_used / (float)FERRY_CAPACITY) * 100);
-        for (int j = 0; j < t->vehicle_count; j++) {
-            for (int k = 0; k < TOTAL_VEHICLES; k++) {
-                if (vehicles[k].id == t->vehicle_ids[j]) {
-                    fprintf(fp, "%s%d ", get_type_name(vehicles[k].type) + 7, t->vehicle_ids[j]);
-                    break;
-                }
+        // Top three sites by time blocked, then by acquisitions
+        int shown[3] = {-1, -1, -1};
+        for (int rank = 0; rank < 3; rank++) {
+            for (int j = 0; j < LOCK_SITES && p->sites[j].func; j++) {
+                LockSite *site = &p->sites[j];
+                if (j == shown[0] || j == shown[1]) continue;
+                LockSite *best = shown[rank] >= 0 ? &p->sites[shown[rank]] : NULL;
+                if (!best || site->wait > best->wait || (site->wait == best->wait && site->count > best->count))
+                    shown[rank] = j;
             }
+            if (shown[rank] < 0) break;
+            LockSite *site = &p->sites[shown[rank]];
+            printf("┃   %-24s line %-5d %8ld acquired, %6ld contended, %.4f s blocked\n",
+                   site->func, site->line, site->count, site->contended, site->wait / 1e9);
         }
-        fprintf(fp, "\n");
     }
-
-    fprintf(fp, "\n=== Vehicle Statistics ===\n");
-    fprintf(fp, "ID | Type      | Start | Wait A | Wait B | Ferry A | Ferry B | Round Trip\n");
-    for (int i = 0; i < TOTAL_VEHICLES; i++) {
-        fprintf(fp, "%2d | %-9s | %-5c | %6.1fs | %6.1fs | %7.1fs | %7.1fs | %8.1fs\n",
-                vehicles[i].id, get_type_name(vehicles[i].type) + 7,
-                vehicles[i].start_port == SIDE_A ? 'A' : 'B',
-                wait_time_a[i], wait_time_b[i], ferry_time_a[i], ferry_time_b[i], round_trip_time[i]);
-    }
-
-    fclose(fp);
+    printf("\033[1m┗━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━┛\n\033[0m");
 }
+#endif
 
-void show_final_statistics() {
-    double total_wait_a = 0, total_wait_b = 0, total_ferry_a = 0, total_ferry_b = 0;
-    double car_wait = 0, minibus_wait = 0, truck_wait = 0;
-    double start_a_wait = 0, start_b_wait = 0;
-    double total_round_trip = 0, max_round_trip = 0, min_round_trip = 1e9;
-    int car_count = 0, minibus_count = 0, truck_count = 0;
-    int start_a_count = 0, start_b_count = 0;
-    double total_duration = 0, total_capacity_used = 0;
-    double max_wait = 0, min_wait = 1e9;
+void show_final_statistics(Simulation *sim) {
+    double total_duration = 0, total_capacity_used = 0, total_fcfs = 0;
     int empty_trips = 0;
 
     printf("\n\033[1m┏━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━ Final Statistics ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━┓\n");
-    printf("┃ Simulation Complete! Total Duration: %ld s | Total Trips: %d \033[0m┃\n",
-           time(NULL) - sim_start_time, trip_count);
-    printf("┣━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━┫\n");
-    printf("┃ ID | Type      | Start | Wait A | Wait B | Ferry A | Ferry B | Round Trip \033[0m┃\n");
-    printf("┣━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━┫\n");
-
-    for (int i = 0; i < TOTAL_VEHICLES; i++) {
-        double total_wait = wait_time_a[i] + wait_time_b[i];
+    printf("┃ Simulation Complete! Total Duration: %.1f s | Total Trips: %d \033[0m┃\n",
+           clock_seconds(sim), sim->trip_count);
+    if (sim->config.vehicle_table) {
+        printf("┣━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━┫\n");
+        printf("┃ ID | Type      | Start | Wait A | Wait B | Ferry A | Ferry B | Round Trip \033[0m┃\n");
+        printf("┣━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━┫\n");
+    }
+    for (int i = 0; sim->config.vehicle_table && i < sim->total_vehicles; i++) {
         printf("┃ %2d | %-9s | %-5c | %6.1fs | %6.1fs | %7.1fs | %7.1fs | %8.1fs \033[0m┃\n",
-               vehicles[i].id, get_type_name(vehicles[i].type) + 7,
-               vehicles[i].start_port == SIDE_A ? 'A' : 'B',
-               wait_time_a[i], wait_time_b[i], ferry_time_a[i], ferry_time_b[i], round_trip_time[i]);
-        total_wait_a += wait_time_a[i];
-        total_wait_b += wait_time_b[i];
-        total_ferry_a += ferry_time_a[i];
-        total_ferry_b += ferry_time_b[i];
-        total_round_trip += round_trip_time[i];
-        if (round_trip_time[i] > max_round_trip) max_round_trip = round_trip_time[i];
-        if (round_trip_time[i] < min_round_trip && round_trip_time[i] > 0) min_round_trip = round_trip_time[i];
-        if (vehicles[i].type == 0) {
-            car_wait += total_wait;
-            car_count++;
-        } else if (vehicles[i].type == 1) {
-            minibus_wait += total_wait;
-            minibus_count++;
-        } else {
-            truck_wait += total_wait;
-            truck_count++;
-        }
-        if (vehicles[i].start_port == SIDE_A) {
-            start_a_wait += total_wait;
-            start_a_count++;
-        } else {
-            start_b_wait += total_wait;
-            start_b_count++;
-        }
-        if (total_wait > max_wait) max_wait = total_wait;
-        if (total_wait < min_wait && total_wait > 0) min_wait = total_wait;
+               sim->vehicles[i].id, get_type_name(sim, sim->vehicles[i].type) + 7,
+               sim->records[i].start_port == SIDE_A ? 'A' : 'B',
+               sim->wait_time_a[i], sim->wait_time_b[i], sim->ferry_time_a[i], sim->ferry_time_b[i], sim->round_trip_time[i]);
     }
 
-    for (int i = 0; i < trip_count; i++) {
-        total_duration += trip_log[i].duration;
-        total_capacity_used += trip_log[i].capacity_used;
-        if (trip_log[i].vehicle_count == 0) empty_trips++;
+    // Averages and extremes come from the histograms, whose sums and bounds are exact
+    LatencyHistogram side_wait[2] = {{0}}, side_ferry[2] = {{0}}, start_wait[2] = {{0}}, class_wait[MAX_VEHICLE_CLASSES] = {{0}};
+    for (int c = 0; c < sim->config.class_count; c++)
+        for (int side = 0; side < 2; side++) {
+            hist_merge(&side_wait[side], latency_hist(sim, sim->latency, LAT_WAIT, c, side));
+            hist_merge(&side_ferry[side], latency_hist(sim, sim->latency, LAT_CROSSING, c, side));
+            hist_merge(&start_wait[side], latency_hist(sim, sim->latency, LAT_TOTAL_WAIT, c, side));
+            hist_merge(&class_wait[c], latency_hist(sim, sim->latency, LAT_TOTAL_WAIT, c, side));
+        }
+    LatencyHistogram total_wait = latency_total(sim, LAT_TOTAL_WAIT), round_trip = latency_total(sim, LAT_ROUND_TRIP);
+    double max_wait = total_wait.max / 1e9, min_wait = total_wait.min / 1e9;
+
+    double total_room = 0; // Capacity offered over every trip, by whichever vessel made it
+    for (int i = 0; i < sim->trip_count; i++) {
+        total_duration += sim->trip_log[i].duration;
+        total_capacity_used += sim->trip_log[i].capacity_used;
+        total_room += trip_capacity(sim, &sim->trip_log[i]);
+        total_fcfs += sim->trip_log[i].fcfs_capacity;
+        if (sim->trip_log[i].vehicle_count == 0) empty_trips++;
     }
 
     printf("┣━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━┫\n");
     printf("┃ \033[1mAvg Wait A: %.2fs | Avg Wait B: %.2fs | Avg Ferry A: %.2fs | Avg Ferry B: %.2fs\033[0m ┃\n",
-           total_wait_a / TOTAL_VEHICLES, total_wait_b / TOTAL_VEHICLES,
-           total_ferry_a / TOTAL_VEHICLES, total_ferry_b / TOTAL_VEHICLES);
-    printf("┃ \033[1mAvg Wait by Type: Car: %.2fs | Minibus: %.2fs | Truck: %.2fs\033[0m ┃\n",
-           car_count ? car_wait / car_count : 0,
-           minibus_count ? minibus_wait / minibus_count : 0,
-           truck_count ? truck_wait / truck_count : 0);
+           hist_mean(&side_wait[SIDE_A]), hist_mean(&side_wait[SIDE_B]),
+           hist_mean(&side_ferry[SIDE_A]), hist_mean(&side_ferry[SIDE_B]));
+    printf("┃ \033[1mAvg Wait by Type:");
+    for (int c = 0, shown = 0; c < sim->config.class_count; c++)
+        if (class_wait[c].count)
+            printf("%s %s: %.2fs", shown++ ? " |" : "", sim->config.classes[c].name, hist_mean(&class_wait[c]));
+    printf("\033[0m ┃\n");
     printf("┃ \033[1mAvg Wait by Start: A: %.2fs | B: %.2fs\033[0m ┃\n",
-           start_a_count ? start_a_wait / start_a_count : 0,
-           start_b_count ? start_b_wait / start_b_count : 0);
+           hist_mean(&start_wait[SIDE_A]), hist_mean(&start_wait[SIDE_B]));
     printf("┃ \033[1mAvg Round Trip: %.2fs | Max: %.2fs | Min: %.2fs\033[0m ┃\n",
-           total_round_trip / TOTAL_VEHICLES, max_round_trip, min_round_trip);
+           hist_mean(&round_trip), round_trip.max / 1e9, round_trip.min / 1e9);
     printf("┃ \033[1mFerry Utilization: %.2f%% | Empty Trips: %d (%.2f%%)\033[0m ┃\n",
-           (total_capacity_used / (trip_count * FERRY_CAPACITY)) * 100,
-           empty_trips, (empty_trips / (float)trip_count) * 100);
+           (total_capacity_used / total_room) * 100,
+           empty_trips, (empty_trips / (float)sim->trip_count) * 100);
+    printf("┃ \033[1mLoad Planner: %.0f units carried vs %.0f FCFS (%+.2f%% utilization)\033[0m ┃\n",
+           total_capacity_used, total_fcfs,
+           ((total_capacity_used - total_fcfs) / total_room) * 100);
     printf("┃ \033[1mStarvation Risk: %s (Max Wait: %.2fs, Min Wait: %.2fs, Ratio: %.2f)\033[0m ┃\n",
            max_wait / (min_wait ? min_wait : 1) > 3 ? "\033[31mHigh\033[0m" : "\033[32mLow\033[0m",
            max_wait, min_wait, max_wait / (min_wait ? min_wait : 1));
+    if (!sim->config.event_mode) {
+        printf("┃ \033[1mBoarding Lock: %lu acquisitions (%.1f per trip)\033[0m ┃\n",
+               sim->boarding_lock_count, sim->trip_count ? sim->boarding_lock_count / (double)sim->trip_count : 0);
+    }
+    printf("┣━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━┫\n");
+    print_latency_table(sim, stdout, "┃ ", " ┃");
+    printf("┣━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━┫\n");
+    print_toll_table(sim, stdout, "┃ ", " ┃");
+    printf("┣━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━┫\n");
+    print_fleet_table(sim, stdout, "┃ ", " ┃");
     printf("\033[1m┗━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━┛\n\033[0m");
+#ifdef LOCK_PROFILE
+    print_lock_profile(sim);
+#endif
+
+    write_log_file(sim);
+    write_json_log(sim);
+}
+
+void print_trip_summary(Simulation *sim) {
+    printf("\n\033[1m┏━━━━━━━━━━━━━━━━━━━━━━━ Trip Summary ━━━━━━━━━━━━━━━━━━━━━━━┓\n");
+    for (int i = 0; i < sim->trip_count; i++) {
+        Trip *t = &sim->trip_log[i];
+        char vessel[32];
+        printf("┃ Trip %d [%s%s]: %.2fs | Capacity: %d/%d (%.1f%%) | FCFS: %d | Vehicles: ",
+               t->trip_id, t->direction == SIDE_A ? "A->B" : "B->A", trip_vessel(sim, t, vessel), t->duration,
+               t->capacity_used, trip_capacity(sim, t), (t->capacity_used / (float)trip_capacity(sim, t)) * 100,
+               t->fcfs_capacity);
+        int *ids = trip_vehicle_ids(sim, t);
+        for (int j = 0; j < t->vehicle_count; j++)
+            printf("%s%d ", get_type_name(sim, vehicle_by_id(sim, ids[j])->type) + 7, ids[j]);
+        printf("%*s┃\n", 30 - t->vehicle_count * 8, "");
+    }
+    printf("┗━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━┛\n\033[0m");
+}
 
-    write_log_file();
+// A macro so the lock profiler sees the caller's line
+#define lock_boarding(sim) do { \
+    LOCK_MUTEX(sim, LK_BOARDING, &(sim)->boarding_mutex); \
+    (sim)->boarding_lock_count++; \
+} while (0)
+
+// Absolute CLOCK_REALTIME deadline for pthread_cond_timedwait
+struct timespec deadline_after(double seconds) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    long nsec = ts.tv_nsec + (long)(seconds * 1e9);
+    ts.tv_sec += nsec / 1000000000;
+    ts.tv_nsec = nsec % 1000000000;
+    return ts;
 }
 
-void* vehicle_func(void* arg) {
-    Vehicle *v = (Vehicle*)arg;
-    v->trip_start = time(NULL);
-    v->wait_duration_b = 1 + (rand() % 5); // Random wait time at Side-B (1-5 seconds)
+// ---------------------------------------------------------------------------
+// Actor runtime: vehicles never block a thread. A vehicle that has to wait is
+// parked on a booth queue, a boarding gate, the ferry or the timer heap, and
+// whoever ends the wait makes it runnable again. Once parked, vehicle_step
+// must not touch the vehicle, since another worker may already be running it.
+// ---------------------------------------------------------------------------
+
+// Make a parked vehicle runnable
+void actor_wake(Simulation *sim, int i) {
+    pthread_mutex_lock(&sim->sched_mutex);
+    sim->vehicles[i].next = -1;
+    if (sim->run_tail < 0) sim->run_head = i;
+    else sim->vehicles[sim->run_tail].next = i;
+    sim->run_tail = i;
+    pthread_cond_signal(&sim->sched_cond);
+    pthread_mutex_unlock(&sim->sched_mutex);
+}
 
-    while (v->boarded < 2 && !final_trip_done) {
-        // Toll booth access
-        int toll_index = (v->port == SIDE_A) ? rand() % TOLL_PER_SIDE : TOLL_PER_SIDE + (rand() % TOLL_PER_SIDE);
-        sem_wait(&toll_sem[toll_index]);
+// Park a vehicle until clock_seconds() reaches the given time
+void actor_sleep_until(Simulation *sim, int i, double time) {
+    pthread_mutex_lock(&sim->sched_mutex);
+    heap_push(&sim->actor_timers, &sim->actor_timer_count, &sim->actor_timer_size, (Event){time, 0, i, sim->actor_timer_seq++});
+    pthread_cond_signal(&sim->sched_cond);
+    pthread_mutex_unlock(&sim->sched_mutex);
+}
 
-        if (v->port == SIDE_A) v->wait_start_a = time(NULL);
-        else v->wait_start_b = time(NULL);
+// A vessel got its berth: release its passengers and empty it. Caller holds boarding_mutex.
+void dock_ferry(Simulation *sim, Ferry *f) {
+    for (int i = 0; i < f->boarded_count; i++) {
+        land_vehicle(sim, f->boarded_ids[i] - 1, f->side);
+        actor_wake(sim, f->boarded_ids[i] - 1);
+    }
+    f->load = 0;
+    f->boarded_count = 0;
+    memset(f->boarded_ids, 0, sizeof(int) * f->spec.capacity);
+    trace_event(sim, f, TR_DOCK, -1, f->side, 0);
+}
 
-        pthread_mutex_lock(&print_mutex);
-        printf("🚗 %s %d passed toll at Side-%c\n", get_type_name(v->type) + 7, v->id,
-               v->port == SIDE_A ? 'A' : 'B');
-        pthread_mutex_unlock(&print_mutex);
-        usleep(100000); // Simulate toll payment
-        sem_post(&toll_sem[toll_index]);
+// Runs a vehicle until it has to wait, then parks it and returns
+void vehicle_step(Simulation *sim, int i) {
+    Vehicle *v = &sim->vehicles[i];
+    VehicleRecord *rec = &sim->records[i];
+    while (1) {
+        switch (v->state) {
+            case V_TOLL:
+                v->toll = toll_choose(sim, v->port, &rec->rng);
+                trace_event(sim, NULL, TR_TOLL_QUEUE, i, v->port, v->toll);
+                if (!booth_arrive(sim, v->toll, i)) return; // Queued behind the booth
+                v->state = V_AT_BOOTH;
+                break;
+            case V_AT_BOOTH:
+                if (v->port == SIDE_A) rec->wait_start_a = sim_now(sim);
+                else rec->wait_start_b = sim_now(sim);
+                trace_event(sim, NULL, TR_TOLL_START, i, v->port, v->toll);
 
-        // Wait for boarding
-        int boarded = 0;
-        while (!boarded && !final_trip_done) {
-            pthread_mutex_lock(&boarding_mutex);
-            if (ferry_side == v->port && ferry_capacity + v->capacity <= FERRY_CAPACITY &&
-                (v->port == SIDE_A || (v->port == SIDE_B && time(NULL) - v->ferry_end_a >= v->wait_duration_b))) {
+                LOCK_MUTEX(sim, LK_PRINT, &print_mutex);
+                printf("🚗 %s %d passed toll at Side-%c\n", get_type_name(sim, v->type) + 7, v->id,
+                       v->port == SIDE_A ? 'A' : 'B');
+                UNLOCK_MUTEX(sim, LK_PRINT, &print_mutex);
+                v->state = V_PAID;
+                actor_sleep_until(sim, i, clock_seconds(sim) + dist_sample(&sim->config.toll_service, &sim->booths[v->toll].rng));
+                return;
+            case V_PAID: {
+                int next = booth_leave(sim, v->toll);
+                if (next >= 0) {
+                    sim->vehicles[next].state = V_AT_BOOTH;
+                    actor_wake(sim, next);
+                }
+                trace_event(sim, NULL, TR_TOLL_EXIT, i, v->port, v->toll);
+                v->state = V_WAITING;
+                break;
+            }
+            case V_WAITING:
+                if (v->ready_time > clock_seconds(sim)) {
+                    // Still resting at Side-B
+                    actor_sleep_until(sim, i, v->ready_time);
+                    return;
+                }
+                // Park in the square; a docked vessel's load planner boards the vehicle
+                // and dock_ferry wakes it on the other side
+                lock_boarding(sim);
+                join_square(sim, i);
+                for (int k = 0; k < sim->ferry_count; k++) {
+                    Ferry *f = &sim->ferries[k];
+                    int room = f->spec.capacity - f->load;
+                    if (f->state == FERRY_DOCKED && f->side == v->port && best_fill(&sim->gate_reach[v->port], room) == room)
+                        pthread_cond_signal(&f->full);
+                }
+                UNLOCK_MUTEX(sim, LK_BOARDING, &sim->boarding_mutex);
+                return;
+            case V_ON_FERRY:
+                // land_vehicle stamped the end of the crossing
                 if (v->port == SIDE_A) {
-                    v->wait_end_a = time(NULL);
-                    wait_time_a[v->id - 1] = difftime(v->wait_end_a, v->wait_start_a);
-                    v->ferry_start_a = time(NULL);
+                    record_vehicle_time(sim, v, LAT_CROSSING, SIDE_A, rec->ferry_end_a - rec->ferry_start_a);
+                    v->port = SIDE_B;
                 } else {
-                    v->wait_end_b = time(NULL);
-                    wait_time_b[v->id - 1] = difftime(v->wait_end_b, v->wait_start_b);
-                    v->ferry_start_b = time(NULL);
+                    record_vehicle_time(sim, v, LAT_CROSSING, SIDE_B, rec->ferry_end_b - rec->ferry_start_b);
+                    v->port = SIDE_A;
                 }
-                ferry_capacity += v->capacity;
-                v->boarded++;
-                boarded_ids[boarded_count++] = v->id;
-                if (v->port == SIDE_A) v->a_trip_no = current_trip_id;
-                else v->b_trip_no = current_trip_id;
-                boarded = 1;
-                pthread_mutex_lock(&print_mutex);
-                printf("✅ %s %d boarded ferry at Side-%c (Capacity: %d)\n",
-                       get_type_name(v->type) + 7, v->id, v->port == SIDE_A ? 'A' : 'B', ferry_capacity);
-                pthread_mutex_unlock(&print_mutex);
-            }
-            pthread_mutex_unlock(&boarding_mutex);
-            if (!boarded) usleep(200000);
-        }
+                trace_event(sim, NULL, TR_UNLOAD, i, v->port, 0);
 
-        if (final_trip_done) break;
-
-        // Wait for ferry to arrive
-        while (ferry_side == v->port && !final_trip_done) usleep(100000);
-
-        if (v->port == SIDE_A) {
-            v->ferry_end_a = time(NULL);
-            ferry_time_a[v->id - 1] = difftime(v->ferry_end_a, v->ferry_start_a);
-            v->port = SIDE_B;
-        } else {
-            v->ferry_end_b = time(NULL);
-            ferry_time_b[v->id - 1] = difftime(v->ferry_end_b, v->ferry_start_b);
-            v->port = SIDE_A;
+                if (v->boarded < 2) {
+                    v->state = V_TOLL;
+                    break;
+                }
+                LOCK_MUTEX(sim, LK_RETURN, &sim->return_mutex);
+                rec->returned = 1;
+                v->state = V_DONE;
+                record_return(sim, v);
+                // publish_snapshot reads the count under boarding_mutex, not this one
+                __atomic_fetch_add(&sim->total_returned, 1, __ATOMIC_RELAXED);
+                trace_event(sim, NULL, TR_RETURNED, i, v->port, 0);
+                LOCK_MUTEX(sim, LK_PRINT, &print_mutex);
+                printf("🏁 %s %d completed round-trip in %.1fs\n",
+                       get_type_name(sim, v->type) + 7, v->id, ns_to_seconds(rec->trip_end - rec->trip_start));
+                UNLOCK_MUTEX(sim, LK_PRINT, &print_mutex);
+                UNLOCK_MUTEX(sim, LK_RETURN, &sim->return_mutex);
+                return;
+            default:
+                return;
         }
+    }
+}
 
-        if (v->boarded == 2) {
-            pthread_mutex_lock(&return_mutex);
-            v->returned = 1;
-            v->trip_end = time(NULL);
-            round_trip_time[v->id - 1] = difftime(v->trip_end, v->trip_start);
-            total_returned++;
-            pthread_mutex_lock(&print_mutex);
-            printf("🏁 %s %d completed round-trip in %.1fs\n",
-                   get_type_name(v->type) + 7, v->id, round_trip_time[v->id - 1]);
-            pthread_mutex_unlock(&print_mutex);
-            pthread_mutex_unlock(&return_mutex);
+void* worker_func(void* arg) {
+    Simulation *sim = arg;
+    pthread_mutex_lock(&sim->sched_mutex);
+    while (!sim->runtime_stopped) {
+        if (sim->run_head >= 0) {
+            int i = sim->run_head;
+            sim->run_head = sim->vehicles[i].next;
+            if (sim->run_head < 0) sim->run_tail = -1;
+            pthread_mutex_unlock(&sim->sched_mutex);
+            vehicle_step(sim, i);
+            pthread_mutex_lock(&sim->sched_mutex);
+        } else if (sim->actor_timer_count > 0) {
+            double due = sim->actor_timers[0].time;
+            if (due <= clock_seconds(sim)) {
+                Event e;
+                heap_pop(sim->actor_timers, &sim->actor_timer_count, &e);
+                sim->vehicles[e.vehicle].next = -1;
+                if (sim->run_tail < 0) sim->run_head = e.vehicle;
+                else sim->vehicles[sim->run_tail].next = e.vehicle;
+                sim->run_tail = e.vehicle;
+            } else {
+                struct timespec until = sim->runtime_start;
+                long nsec = until.tv_nsec + (long)((due - (long)due) * 1e9);
+                until.tv_sec += (long)due + nsec / 1000000000;
+                until.tv_nsec = nsec % 1000000000;
+                pthread_cond_timedwait(&sim->sched_cond, &sim->sched_mutex, &until);
+            }
+        } else {
+            pthread_cond_wait(&sim->sched_cond, &sim->sched_mutex);
         }
     }
+    pthread_mutex_unlock(&sim->sched_mutex);
+    trace_thread_exit(sim);
+    latency_thread_exit(sim);
     return NULL;
 }
 
+void stop_actor_runtime(Simulation *sim) {
+    pthread_mutex_lock(&sim->sched_mutex);
+    sim->runtime_stopped = 1;
+    pthread_cond_broadcast(&sim->sched_cond);
+    pthread_mutex_unlock(&sim->sched_mutex);
+}
+
+typedef struct {
+    Simulation *sim;
+    Ferry *ferry;
+} FerryThread;
+
+// Real-time mode: block until release_berth hands f a berth. Returns 0 if the
+// run ended first. Caller holds boarding_mutex.
+int wait_for_berth(Simulation *sim, Ferry *f) {
+    while (f->state == FERRY_WAITING && !sim->final_trip_done) {
+        struct timespec until = deadline_after(sim->config.poll_interval);
+        COND_TIMEDWAIT(sim, LK_BOARDING, &f->full, &sim->boarding_mutex, &until);
+        sim->boarding_lock_count++;
+    }
+    return f->state != FERRY_WAITING;
+}
+
+// One thread per vessel
 void* ferry_func(void* arg) {
-    int wait_counter = 0;
-    while (!final_trip_done) {
-        time_t start_time = time(NULL);
-        int should_depart = 0;
+    Simulation *sim = ((FerryThread *)arg)->sim;
+    Ferry *f = ((FerryThread *)arg)->ferry;
+    const char *name = sim->ferry_count > 1 ? f->spec.name : "Ferry";
+    while (!__atomic_load_n(&sim->final_trip_done, __ATOMIC_ACQUIRE)) {
+        int should_depart = 0, fcfs_load = 0;
 
-        pthread_mutex_lock(&boarding_mutex);
-        if (is_first_return && ferry_side == SIDE_B) {
+        lock_boarding(sim);
+        if (!wait_for_berth(sim, f)) {
+            // Queued at Side-A from the start and never needed
+            UNLOCK_MUTEX(sim, LK_BOARDING, &sim->boarding_mutex);
+            break;
+        }
+        if (sim->is_first_return && f->side == SIDE_B) {
             // First return trip from Side-B to Side-A is empty
-            should_depart = 1;
-            printf("\n\033[36m⛴️ Ferry departing from Side-B to Side-A (Empty First Return)\033[0m\n");
-            double duration = 2 + (rand() % 8);
-            log_trip(ferry_side, duration, boarded_ids, 0, 0);
-            current_trip_id++;
-            pthread_mutex_unlock(&boarding_mutex);
-            usleep(duration * 1000000);
-            ferry_side = SIDE_A;
-            is_first_return = 0;
-            wait_counter = 0;
-            continue;
-        }
-        pthread_mutex_unlock(&boarding_mutex);
-
-        while (!should_depart) {
-            pthread_mutex_lock(&boarding_mutex);
-            int vehicles_waiting = 0;
-            for (int i = 0; i < TOTAL_VEHICLES; i++) {
-                if (vehicles[i].port == ferry_side && !vehicles[i].returned && vehicles[i].boarded < 2) {
-                    if (ferry_side == SIDE_A || (ferry_side == SIDE_B && time(NULL) - vehicles[i].ferry_end_a >= vehicles[i].wait_duration_b)) {
-                        vehicles_waiting = 1;
-                        break;
-                    }
-                }
-            }
-            if (ferry_capacity >= FERRY_CAPACITY || !vehicles_waiting || wait_counter >= 10) {
-                should_depart = 1;
-                if (!vehicles_waiting && ferry_capacity == 0) {
-                    printf("🚨 No vehicles waiting at Side-%c, ferry waiting...\n",
-                           ferry_side == SIDE_A ? 'A' : 'B');
+            printf("\n\033[36m⛴️ %s departing from Side-B to Side-A (Empty First Return)\033[0m\n", name);
+            sim->is_first_return = 0;
+            f->trip_id = sim->current_trip_id++;
+        } else {
+            while (!should_depart) {
+                should_depart = ferry_should_depart(sim, f, f->checks);
+                f->checks++;
+                publish_snapshot(sim, 0);
+                if (!should_depart) {
+                    // Next check after the poll interval, or right away once the square can fill the vessel
+                    struct timespec until = deadline_after(sim->config.poll_interval);
+                    COND_TIMEDWAIT(sim, LK_BOARDING, &f->full, &sim->boarding_mutex, &until);
+                    sim->boarding_lock_count++;
                 }
             }
-            wait_counter++;
-            pthread_mutex_unlock(&boarding_mutex);
-            if (!should_depart) usleep(250000);
-        }
 
-        pthread_mutex_lock(&boarding_mutex);
-        if (ferry_capacity > 0) {
-            printf("\n\033[36m⛴️ Ferry departing from Side-%c to Side-%c with %d units\033[0m\n",
-                   ferry_side == SIDE_A ? 'A' : 'B',
-                   ferry_side == SIDE_A ? 'B' : 'A',
-                   ferry_capacity);
+            f->trip_id = sim->current_trip_id++;
+            fcfs_load = board_planned_load(sim, f);
+            if (f->load > 0) {
+                printf("\n\033[36m⛴️ %s departing from Side-%c to Side-%c with %d units (FCFS: %d)\033[0m\n", name,
+                       f->side == SIDE_A ? 'A' : 'B', f->side == SIDE_A ? 'B' : 'A', f->load, fcfs_load);
+            } else {
+                printf("🚨 No vehicles waiting at Side-%c, %s leaving empty...\n", f->side == SIDE_A ? 'A' : 'B', name);
+            }
         }
 
-        double duration = 2 + (rand() % 8);
-        log_trip(ferry_side, duration, boarded_ids, boarded_count, ferry_capacity);
-        current_trip_id++;
+        double duration = dist_sample(&sim->config.crossing_time, &f->rng) / f->spec.speed;
+        log_trip(sim, f, duration, fcfs_load);
+        Ferry *next = release_berth(sim, f);
+        if (next) pthread_cond_signal(&next->full);
+        publish_snapshot(sim, 1);
+        UNLOCK_MUTEX(sim, LK_BOARDING, &sim->boarding_mutex);
         usleep(duration * 1000000);
 
-        ferry_side = 1 - ferry_side;
-        ferry_capacity = 0;
-        wait_counter = 0;
-        boarded_count = 0;
-        memset(boarded_ids, 0, sizeof(boarded_ids));
-
-        pthread_mutex_lock(&return_mutex);
-        if (total_returned >= TOTAL_VEHICLES && ferry_side == SIDE_A) {
-            final_trip_done = 1;
+        lock_boarding(sim);
+        f->side = 1 - f->side;
+        trace_event(sim, f, TR_ARRIVE, -1, f->side, 0);
+        // With every berth taken, release_berth hands one over first come first served
+        if (!request_berth(sim, f) && !wait_for_berth(sim, f)) {
+            // Everyone is home, and a vessel waiting for a berth carries nobody
+            UNLOCK_MUTEX(sim, LK_BOARDING, &sim->boarding_mutex);
+            break;
         }
-        pthread_mutex_unlock(&return_mutex);
-        pthread_mutex_unlock(&boarding_mutex);
-    }
+        dock_ferry(sim, f);
+        f->checks = 0;
 
-    // Print trip summary
-    printf("\n\033[1m┏━━━━━━━━━━━━━━━━━━━━━━━ Trip Summary ━━━━━━━━━━━━━━━━━━━━━━━┓\n");
-    for (int i = 0; i < trip_count; i++) {
-        Trip *t = &trip_log[i];
-        printf("┃ Trip %d [%s]: %.2fs | Capacity: %d/%d (%.1f%%) | Vehicles: ",
-               t->trip_id, t->direction == SIDE_A ? "A->B" : "B->A", t->duration,
-               t->capacity_used, FERRY_CAPACITY, (t->capacity_used / (float)FERRY_CAPACITY) * 100);
-        for (int j = 0; j < t->vehicle_count; j++) {
-            for (int k = 0; k < TOTAL_VEHICLES; k++) {
-                if (vehicles[k].id == t->vehicle_ids[j]) {
-                    printf("%s%d ", get_type_name(vehicles[k].type) + 7, t->vehicle_ids[j]);
-                    break;
-                }
-            }
+        LOCK_MUTEX(sim, LK_RETURN, &sim->return_mutex);
+        if (sim->total_returned >= sim->total_vehicles && f->side == SIDE_A) {
+            __atomic_store_n(&sim->final_trip_done, 1, __ATOMIC_RELEASE);
         }
-        printf("%*s┃\n", 30 - t->vehicle_count * 8, "");
+        UNLOCK_MUTEX(sim, LK_RETURN, &sim->return_mutex);
+        publish_snapshot(sim, 1);
+        UNLOCK_MUTEX(sim, LK_BOARDING, &sim->boarding_mutex);
     }
-    printf("┗━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━┛\n\033[0m");
+
+    trace_thread_exit(sim);
+    latency_thread_exit(sim);
     return NULL;
 }
 
 void* print_state_thread(void* arg) {
+    Simulation *sim = arg;
     int wait_counter = 0;
-    while (!final_trip_done) {
-        print_state(wait_counter);
+    while (!__atomic_load_n(&sim->final_trip_done, __ATOMIC_ACQUIRE)) {
+        print_state(sim, wait_counter);
         wait_counter++;
         usleep(500000); // Update every 0.5 seconds
     }
-    print_state(wait_counter); // Final state
+    print_state(sim, wait_counter); // Final state
+    return NULL;
+}
+
+void* plaza_thread(void* arg) {
+    Simulation *sim = arg;
+    int started[2];
+    while (!__atomic_load_n(&sim->final_trip_done, __ATOMIC_ACQUIRE)) {
+        plaza_control(sim, started);
+        for (int side = 0; side < 2; side++)
+            if (started[side] >= 0) {
+                sim->vehicles[started[side]].state = V_AT_BOOTH;
+                actor_wake(sim, started[side]);
+            }
+        usleep(sim->config.toll_scale_interval * 1000000);
+    }
     return NULL;
 }
 
-int main() {
-    srand(time(NULL));
-    sim_start_time = time(NULL);
-    pthread_t vehicle_threads[TOTAL_VEHICLES];
-    pthread_t ferry_thread, printer_thread;
+// ---------------------------------------------------------------------------
+// Discrete-event mode: the same scenario driven by a virtual clock. Events are
+// kept in a binary heap ordered by (time, type, seq) and processed until every
+// vehicle has returned, so no actor ever sleeps.
+// ---------------------------------------------------------------------------
 
-    // Initialize semaphores
-    for (int i = 0; i < 4; i++) sem_init(&toll_sem[i], 0, 1);
+void schedule_event(Simulation *sim, double time, int type, int vehicle) {
+    heap_push(&sim->event_queue, &sim->event_count, &sim->event_queue_size, (Event){time, type, vehicle, sim->event_seq++});
+}
 
-    // Initialize vehicles, all start at Side-A
-    int id = 1;
-    for (int i = 0; i < CAR_COUNT; i++) {
-        vehicles[i] = (Vehicle){id++, 0, 1, SIDE_A, SIDE_A, 0, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+int pop_event(Simulation *sim, Event *out) {
+    return heap_pop(sim->event_queue, &sim->event_count, out);
+}
+
+// Start serving the vehicle at its booth; payment ends one service time later
+void start_toll_service(Simulation *sim, int i) {
+    Vehicle *v = &sim->vehicles[i];
+    VehicleRecord *rec = &sim->records[i];
+    v->state = V_AT_BOOTH;
+    if (v->port == SIDE_A) rec->wait_start_a = sim_now(sim);
+    else rec->wait_start_b = sim_now(sim);
+    trace_event(sim, NULL, TR_TOLL_START, i, v->port, v->toll);
+    schedule_event(sim, sim->sim_clock + dist_sample(&sim->config.toll_service, &sim->booths[v->toll].rng), EV_TOLL_EXIT, i);
+}
+
+// A vessel got its berth: its passengers drive off and it starts loading
+void arrive_ferry(Simulation *sim, Ferry *f) {
+    for (int i = 0; i < f->boarded_count; i++) {
+        land_vehicle(sim, f->boarded_ids[i] - 1, f->side);
+        schedule_event(sim, sim->sim_clock, EV_UNLOAD, f->boarded_ids[i] - 1);
+    }
+    f->load = 0;
+    f->boarded_count = 0;
+    f->checks = 0;
+    trace_event(sim, f, TR_DOCK, -1, f->side, 0);
+    schedule_event(sim, sim->sim_clock, EV_DEPART, f - sim->ferries);
+}
+
+void depart_ferry(Simulation *sim, Ferry *f) {
+    f->trip_id = sim->current_trip_id++;
+    int fcfs_load = board_planned_load(sim, f);
+    double duration = dist_sample(&sim->config.crossing_time, &f->rng) / f->spec.speed;
+    log_trip(sim, f, duration, fcfs_load);
+    Ferry *next = release_berth(sim, f);
+    schedule_event(sim, sim->sim_clock + duration, EV_ARRIVE, f - sim->ferries);
+    if (next) arrive_ferry(sim, next);
+}
+
+void handle_event(Simulation *sim, Event *e) {
+    int ferry_event = e->type == EV_DEPART || e->type == EV_ARRIVE;
+    Ferry *f = ferry_event ? &sim->ferries[e->vehicle] : NULL;
+    Vehicle *v = !ferry_event && e->vehicle >= 0 ? &sim->vehicles[e->vehicle] : NULL;
+    VehicleRecord *rec = !ferry_event && e->vehicle >= 0 ? &sim->records[e->vehicle] : NULL;
+    switch (e->type) {
+        case EV_TOLL_ENTRY:
+            v->state = V_TOLL;
+            v->toll = toll_choose(sim, v->port, &rec->rng);
+            trace_event(sim, NULL, TR_TOLL_QUEUE, e->vehicle, v->port, v->toll);
+            if (booth_arrive(sim, v->toll, e->vehicle)) start_toll_service(sim, e->vehicle);
+            break;
+        case EV_TOLL_EXIT: {
+            trace_event(sim, NULL, TR_TOLL_EXIT, e->vehicle, v->port, v->toll);
+            int next = booth_leave(sim, v->toll);
+            if (next >= 0) start_toll_service(sim, next);
+            schedule_event(sim, v->ready_time > sim->sim_clock ? v->ready_time : sim->sim_clock, EV_BOARD, e->vehicle);
+            break;
+        }
+        case EV_BOARD:
+            join_square(sim, e->vehicle);
+            break;
+        case EV_DEPART:
+            if (sim->final_trip_done) break;
+            if (sim->is_first_return && f->side == SIDE_B) {
+                // The first departure from Side-B skips the departure checks
+                sim->is_first_return = 0;
+                depart_ferry(sim, f);
+            } else if (ferry_should_depart(sim, f, f->checks)) {
+                depart_ferry(sim, f);
+            } else {
+                f->checks++;
+                schedule_event(sim, sim->sim_clock + sim->config.poll_interval, EV_DEPART, e->vehicle);
+            }
+            break;
+        case EV_ARRIVE:
+            f->side = 1 - f->side;
+            trace_event(sim, f, TR_ARRIVE, -1, f->side, 0);
+            if (request_berth(sim, f)) arrive_ferry(sim, f);
+            break;
+        case EV_TOLL_SCALE: {
+            int started[2];
+            plaza_control(sim, started);
+            for (int side = 0; side < 2; side++)
+                if (started[side] >= 0) start_toll_service(sim, started[side]);
+            schedule_event(sim, sim->sim_clock + sim->config.toll_scale_interval, EV_TOLL_SCALE, -1);
+            break;
+        }
+        case EV_UNLOAD:
+            // land_vehicle stamped the end of the crossing
+            if (v->port == SIDE_A) {
+                record_vehicle_time(sim, v, LAT_CROSSING, SIDE_A, rec->ferry_end_a - rec->ferry_start_a);
+                v->port = SIDE_B;
+            } else {
+                record_vehicle_time(sim, v, LAT_CROSSING, SIDE_B, rec->ferry_end_b - rec->ferry_start_b);
+                v->port = SIDE_A;
+            }
+            trace_event(sim, NULL, TR_UNLOAD, e->vehicle, v->port, 0);
+            schedule_event(sim, sim->sim_clock, v->boarded == 2 ? EV_RETURN : EV_TOLL_ENTRY, e->vehicle);
+            break;
+        case EV_RETURN:
+            v->state = V_DONE;
+            rec->returned = 1;
+            record_return(sim, v);
+            sim->total_returned++;
+            trace_event(sim, NULL, TR_RETURNED, e->vehicle, v->port, 0);
+            if (sim->total_returned >= sim->total_vehicles) sim->final_trip_done = 1; // Every vehicle ends at Side-A
+            break;
+    }
+}
+
+// Returns the number of events processed
+// The events at time 0: every vehicle heads for the tolls and every vessel that got a berth checks for departure
+void schedule_start(Simulation *sim) {
+    for (int i = 0; i < sim->total_vehicles; i++) schedule_event(sim, 0, EV_TOLL_ENTRY, i);
+    queue_fleet(sim);
+    for (int k = 0; k < sim->ferry_count; k++)
+        if (sim->ferries[k].state == FERRY_DOCKED) schedule_event(sim, 0, EV_DEPART, k);
+    if (sim->config.toll_autoscale) schedule_event(sim, 0, EV_TOLL_SCALE, -1);
+}
+
+unsigned long run_event_simulation(Simulation *sim) {
+    schedule_start(sim);
+    Event e;
+    unsigned long processed = 0;
+    while (!sim->final_trip_done && pop_event(sim, &e)) {
+        sim->sim_clock = e.time;
+        handle_event(sim, &e);
+        processed++;
+    }
+    trace_thread_exit(sim);
+    latency_thread_exit(sim);
+    free(sim->event_queue);
+    sim->event_queue = NULL;
+    sim->event_count = sim->event_queue_size = 0;
+    return processed;
+}
+
+const SimConfig default_config = {
+    .classes = {{"Car", 1, 25}, {"Minibus", 2, 15}, {"Truck", 4, 10}},
+    .class_count = 3,
+    .ferry_capacity = 50, .berths = 1, .toll_per_side = 2, .toll_policy = TOLL_TWO,
+    .toll_min_open = 1, .toll_scale_up = 2, .toll_scale_down = 0.5, .toll_scale_interval = 1,
+    .toll_service = {DIST_FIXED, 0.1, 0},
+    .crossing_time = {DIST_INTEGER, 2, 9},
+    .dwell_time = {DIST_INTEGER, 1, 5},
+    .departure_policy = DEPART_PLANNED, .max_ferry_checks = 10, .poll_interval = 0.25,
+    .vehicle_table = 1,
+};
+
+int config_vehicle_count(const SimConfig *config) {
+    int n = 0;
+    for (int c = 0; c < config->class_count; c++) n += config->classes[c].count;
+    return n;
+}
+
+VehicleClass *config_find_class(SimConfig *config, const char *name, size_t len) {
+    for (int c = 0; c < config->class_count; c++)
+        if (strlen(config->classes[c].name) == len && strncasecmp(config->classes[c].name, name, len) == 0)
+            return &config->classes[c];
+    return NULL;
+}
+
+// Apply one KEY=VALUE setting, from a config file or the command line.
+// Keys are the old compile-time names (FERRY_CAPACITY, TOLL_PER_SIDE, ...);
+// CLASS=Name:capacity:count adds or redefines a vehicle class, and
+// <NAME>_COUNT=n sets how many vehicles of an existing class take part
+// (0 leaves the class out). FERRY=Name:capacity[:speed] adds or redefines a
+// vessel; without any the fleet is one ferry of FERRY_CAPACITY.
+int config_set(SimConfig *config, const char *key, const char *value) {
+    size_t len = strlen(key);
+    char *end;
+    long number = strtol(value, &end, 10);
+    int is_number = *value && *end == '\0';
+
+    if (strcasecmp(key, "CLASS") == 0) {
+        char name[sizeof(config->classes[0].name)];
+        int capacity, count, n = -1;
+        if (sscanf(value, "%15[^:]:%d:%d%n", name, &capacity, &count, &n) != 3 || value[n] != '\0') return -1;
+        VehicleClass *vc = config_find_class(config, name, strlen(name));
+        if (!vc) {
+            if (config->class_count == MAX_VEHICLE_CLASSES) return -1;
+            vc = &config->classes[config->class_count++];
+        }
+        snprintf(vc->name, sizeof(vc->name), "%s", name);
+        vc->capacity = capacity;
+        vc->count = count;
+    } else if (strcasecmp(key, "FERRY") == 0) {
+        char name[sizeof(config->vessels[0].name)];
+        int capacity, n = -1;
+        double speed = 1;
+        if (sscanf(value, "%15[^:]:%d%n", name, &capacity, &n) != 2) return -1;
+        if (value[n] == ':') {
+            speed = strtod(value + n + 1, &end);
+            if (end == value + n + 1 || *end) return -1;
+        } else if (value[n] != '\0') return -1;
+        VesselSpec *spec = NULL;
+        for (int k = 0; k < config->vessel_count; k++)
+            if (strcasecmp(config->vessels[k].name, name) == 0) spec = &config->vessels[k];
+        if (!spec) {
+            if (config->vessel_count == MAX_FERRIES) return -1;
+            spec = &config->vessels[config->vessel_count++];
+        }
+        snprintf(spec->name, sizeof(spec->name), "%s", name);
+        spec->capacity = capacity;
+        spec->speed = speed;
+    } else if (len > 6 && strcasecmp(key + len - 6, "_COUNT") == 0 && is_number) {
+        VehicleClass *vc = config_find_class(config, key, len - 6);
+        if (!vc) return -1;
+        vc->count = number;
+    } else if (strcasecmp(key, "FERRY_CAPACITY") == 0 && is_number) config->ferry_capacity = number;
+    else if (strcasecmp(key, "BERTHS") == 0 && is_number) config->berths = number;
+    else if (strcasecmp(key, "TOLL_PER_SIDE") == 0 && is_number) config->toll_per_side = number;
+    else if (strcasecmp(key, "TOLL_AUTOSCALE") == 0 && is_number) config->toll_autoscale = number != 0;
+    else if (strcasecmp(key, "TOLL_MIN_OPEN") == 0 && is_number) config->toll_min_open = number;
+    else if (strcasecmp(key, "MAX_FERRY_CHECKS") == 0 && is_number) config->max_ferry_checks = number;
+    else if (strcasecmp(key, "VEHICLE_TABLE") == 0 && is_number) config->vehicle_table = number != 0;
+    else if (strcasecmp(key, "SEED") == 0 && is_number) config->seed = strtoull(value, NULL, 10);
+    else if (strcasecmp(key, "TOLL_SERVICE_TIME") == 0) return parse_distribution(value, &config->toll_service);
+    else if (strcasecmp(key, "CROSSING_TIME") == 0) return parse_distribution(value, &config->crossing_time);
+    else if (strcasecmp(key, "DWELL_TIME") == 0) return parse_distribution(value, &config->dwell_time);
+    else if (strcasecmp(key, "FERRY_POLL_INTERVAL") == 0) {
+        config->poll_interval = strtod(value, &end);
+        if (*end || config->poll_interval <= 0) return -1;
+    } else if (strcasecmp(key, "TOLL_SCALE_UP") == 0 || strcasecmp(key, "TOLL_SCALE_DOWN") == 0 ||
+               strcasecmp(key, "TOLL_SCALE_INTERVAL") == 0) {
+        double seconds = strtod(value, &end);
+        if (*end || seconds < 0) return -1;
+        if (strcasecmp(key, "TOLL_SCALE_UP") == 0) config->toll_scale_up = seconds;
+        else if (strcasecmp(key, "TOLL_SCALE_DOWN") == 0) config->toll_scale_down = seconds;
+        else if (seconds > 0) config->toll_scale_interval = seconds;
+        else return -1;
+    } else if (strcasecmp(key, "TOLL_POLICY") == 0) {
+        if (strcasecmp(value, "random") == 0) config->toll_policy = TOLL_RANDOM;
+        else if (strcasecmp(value, "shortest") == 0) config->toll_policy = TOLL_SHORTEST;
+        else if (strcasecmp(value, "two") == 0) config->toll_policy = TOLL_TWO;
+        else return -1;
+    } else if (strcasecmp(key, "DEPARTURE_POLICY") == 0) {
+        if (strcasecmp(value, "planned") == 0) config->departure_policy = DEPART_PLANNED;
+        else if (strcasecmp(value, "full") == 0) config->departure_policy = DEPART_FULL;
+        else return -1;
+    } else return -1;
+    return 0;
+}
+
+// "KEY=VALUE" as given on the command line
+int config_set_pair(SimConfig *config, const char *pair) {
+    char key[64];
+    const char *eq = strchr(pair, '=');
+    if (!eq || eq == pair || eq - pair >= (long)sizeof(key)) return -1;
+    memcpy(key, pair, eq - pair);
+    key[eq - pair] = '\0';
+    return config_set(config, key, eq + 1);
+}
+
+// KEY=VALUE lines; blank lines and # comments are skipped
+int load_config(SimConfig *config, const char *path) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        fprintf(stderr, "Error: Could not open %s.\n", path);
+        return -1;
+    }
+    char line[256];
+    int line_no = 0, status = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        line_no++;
+        line[strcspn(line, "#\r\n")] = '\0';
+        char *pair = line + strspn(line, " \t");
+        if (!*pair) continue;
+        if (config_set_pair(config, pair) < 0) {
+            fprintf(stderr, "Error: %s:%d: bad setting '%s'.\n", path, line_no, pair);
+            status = -1;
+        }
+    }
+    fclose(fp);
+    return status;
+}
+
+// Resize the fleet to vehicles in total, keeping the class mix
+void config_scale_vehicles(SimConfig *config, int vehicles) {
+    int total = config_vehicle_count(config), assigned = 0;
+    for (int c = 0; c < config->class_count; c++) {
+        config->classes[c].count = (long)vehicles * config->classes[c].count / total;
+        assigned += config->classes[c].count;
+    }
+    config->classes[config->class_count - 1].count += vehicles - assigned;
+}
+
+// Capacity of the largest vessel: every class has to fit on it
+int config_largest_vessel(const SimConfig *config) {
+    int largest = config->vessel_count ? 0 : config->ferry_capacity;
+    for (int k = 0; k < config->vessel_count; k++)
+        if (config->vessels[k].capacity > largest) largest = config->vessels[k].capacity;
+    return largest;
+}
+
+// Reject configurations the simulation can't finish
+int config_check(const SimConfig *config) {
+    if (config->class_count < 1 || config_vehicle_count(config) < 1) {
+        fprintf(stderr, "Error: configuration has no vehicles.\n");
+        return -1;
+    }
+    for (int k = 0; k < config->vessel_count; k++) {
+        if (config->vessels[k].capacity < 1 || !(config->vessels[k].speed > 0)) {
+            fprintf(stderr, "Error: ferry %s needs capacity >= 1 and speed > 0.\n", config->vessels[k].name);
+            return -1;
+        }
     }
-    for (int i = 0; i < MINIBUS_COUNT; i++) {
-        vehicles[CAR_COUNT + i] = (Vehicle){id++, 1, 2, SIDE_A, SIDE_A, 0, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    for (int c = 0; c < config->class_count; c++) {
+        const VehicleClass *vc = &config->classes[c];
+        if (vc->count < 0 || (vc->count > 0 && (vc->capacity < 1 || vc->capacity > config_largest_vessel(config)))) {
+            fprintf(stderr, "Error: class %s needs 1 <= capacity <= the largest ferry's and count >= 0.\n", vc->name);
+            return -1;
+        }
+    }
+    if (config->berths < 1) {
+        fprintf(stderr, "Error: BERTHS must be >= 1.\n");
+        return -1;
+    }
+    if (config->toll_per_side < 1 || config->max_ferry_checks < 0) {
+        fprintf(stderr, "Error: TOLL_PER_SIDE must be >= 1 and MAX_FERRY_CHECKS >= 0.\n");
+        return -1;
+    }
+    if (config->toll_autoscale && (config->toll_min_open < 1 || config->toll_min_open > config->toll_per_side ||
+                                   config->toll_scale_down >= config->toll_scale_up)) {
+        fprintf(stderr, "Error: autoscaling needs 1 <= TOLL_MIN_OPEN <= TOLL_PER_SIDE and TOLL_SCALE_DOWN < TOLL_SCALE_UP.\n");
+        return -1;
+    }
+    return 0;
+}
+
+// A new simulation with every buffer sized from config and all vehicles at Side-A
+Simulation *simulation_create(const SimConfig *config) {
+    Simulation *sim = calloc(1, sizeof(Simulation));
+    if (!sim) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+    sim->config = *config;
+    if (!config->vessel_count) {
+        sim->config.vessels[0] = (VesselSpec){"Ferry", config->ferry_capacity, 1};
+        sim->config.vessel_count = 1;
+    }
+    // Reachability and the load planner are sized for the largest vessel
+    sim->config.ferry_capacity = config_largest_vessel(&sim->config);
+    sim->total_vehicles = config_vehicle_count(config);
+    int n = sim->total_vehicles, capacity = sim->config.ferry_capacity, booths = 2 * config->toll_per_side;
+    sim->vehicles = calloc(n, sizeof(Vehicle));
+    sim->records = calloc(n, sizeof(VehicleRecord));
+    sim->ferry_count = sim->config.vessel_count;
+    sim->ferries = calloc(sim->ferry_count, sizeof(Ferry));
+    for (int k = 0; sim->ferries && k < sim->ferry_count; k++) {
+        Ferry *f = &sim->ferries[k];
+        f->spec = sim->config.vessels[k];
+        f->side = SIDE_A;
+        f->next = -1;
+        f->boarded_ids = calloc(f->spec.capacity, sizeof(int));
+        if (!f->boarded_ids) {
+            printf("Memory allocation failed\n");
+            exit(1);
+        }
+        // The first vessel keeps the stream the lone ferry always had
+        rng_seed(&f->rng, config->seed, k ? RNG_STREAM_VESSEL + k : RNG_STREAM_FERRY);
+        pthread_cond_init(&f->full, NULL);
+    }
+    for (int side = 0; side < 2; side++) {
+        sim->side_reach[side] = (Reachability){.classes = sim->config.classes, .class_count = config->class_count,
+                                               .limit = capacity, .dirty = 1};
+        sim->side_reach[side].bits = calloc(REACH_WORDS(&sim->side_reach[side]), sizeof(uint64_t));
+        sim->gate_reach[side] = (Reachability){.classes = sim->config.classes, .class_count = config->class_count,
+                                               .limit = capacity, .dirty = 1};
+        sim->gate_reach[side].bits = calloc(REACH_WORDS(&sim->gate_reach[side]), sizeof(uint64_t));
+        for (int c = 0; c < MAX_VEHICLE_CLASSES; c++) sim->gate_head[side][c] = sim->gate_tail[side][c] = -1;
+    }
+    sim->planner_prefix = calloc(config->class_count * (capacity + 1), sizeof(double));
+    sim->planner_wait = calloc(2 * (capacity + 1), sizeof(double));
+    sim->planner_pick = calloc(config->class_count * (capacity + 1), sizeof(PlanCandidate));
+    sim->planner_take = calloc(config->class_count * (capacity + 1), sizeof(int));
+    int table = config->vehicle_table ? n : 0; // Without the table, timings only go to the histograms
+    sim->wait_time_a = calloc(table, sizeof(double));
+    sim->wait_time_b = calloc(table, sizeof(double));
+    sim->ferry_time_a = calloc(table, sizeof(double));
+    sim->ferry_time_b = calloc(table, sizeof(double));
+    sim->round_trip_time = calloc(table, sizeof(double));
+    sim->latency = calloc((size_t)LAT_METRICS * config->class_count * 2, sizeof(LatencyHistogram));
+    sim->booths = aligned_alloc(_Alignof(TollBooth), booths * sizeof(TollBooth));
+#ifdef LOCK_PROFILE
+    sim->lock_profile = calloc(LK_LOCKS, sizeof(LockProfile));
+    if (!sim->lock_profile) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+#endif
+    if (!sim->vehicles || !sim->records || !sim->ferries || !sim->planner_prefix || !sim->planner_wait ||
+        !sim->planner_take || !sim->planner_pick || (table && (!sim->wait_time_a || !sim->wait_time_b || !sim->ferry_time_a ||
+        !sim->ferry_time_b || !sim->round_trip_time)) || !sim->latency || !sim->booths) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+    // Without autoscaling every booth is open for the whole run
+    int open = config->toll_autoscale ? config->toll_min_open : config->toll_per_side;
+    sim->toll_open[SIDE_A] = sim->toll_open[SIDE_B] = open;
+    for (int i = 0; i < booths; i++) {
+        sim->booths[i] = (TollBooth){.head = -1, .tail = -1, .opened_at = i % config->toll_per_side < open ? 0 : -1};
+        pthread_mutex_init(&sim->booths[i].mutex, NULL);
+        rng_seed(&sim->booths[i].rng, config->seed, RNG_STREAM_TOLL + i);
+    }
+
+    for (int side = 0; side < 2; side++) {
+        sim->berths_free[side] = config->berths;
+        sim->berth_head[side] = sim->berth_tail[side] = -1;
+    }
+    sim->is_first_return = 1;
+    sim->trace_fd = -1;
+    sim->run_head = sim->run_tail = -1;
+    sim->sim_start_time = time(NULL);
+    clock_gettime(CLOCK_MONOTONIC, &sim->runtime_start);
+    pthread_mutex_init(&sim->boarding_mutex, NULL);
+    pthread_mutex_init(&sim->return_mutex, NULL);
+    pthread_mutex_init(&sim->log_mutex, NULL);
+    pthread_mutex_init(&sim->sched_mutex, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&sim->sched_cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    // Console labels cycle through a few colours
+    static const char *colours[] = {"32m🟢", "34m🔵", "33m🟡", "35m🟣", "31m🟠", "36m🟤"};
+    int id = 1;
+    for (int c = 0; c < config->class_count; c++) {
+        const VehicleClass *vc = &config->classes[c];
+        snprintf(sim->type_label[c], sizeof(sim->type_label[c]), "\033[%s %s\033[0m", colours[c % 6], vc->name);
+        for (int i = 0; i < vc->count; i++, id++)
+            sim->vehicles[id - 1] = (Vehicle){.id = id, .type = c, .port = SIDE_A, .capacity = vc->capacity, .next = -1};
     }
-    for (int i = 0; i < TRUCK_COUNT; i++) {
-        vehicles[CAR_COUNT + MINIBUS_COUNT + i] = (Vehicle){id++, 2, 4, SIDE_A, SIDE_A, 0, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    for (int i = 0; i < n; i++) {
+        Vehicle *v = &sim->vehicles[i];
+        VehicleRecord *rec = &sim->records[i];
+        rec->start_port = v->port;
+        rec->a_trip_no = rec->b_trip_no = -1;
+        rec->trip_start = sim_now(sim);
+        rng_seed(&rec->rng, config->seed, v->id);
+        rec->wait_duration_b = dist_sample(&config->dwell_time, &rec->rng); // Rest at Side-B
+        reach_add(&sim->side_reach[v->port], v->type);
     }
+    return sim;
+}
+
+// Run until every vehicle is back at Side-A: on the event engine in event mode,
+// otherwise on the ferry, printer and worker threads in real time. Returns the
+// number of events processed in event mode.
+unsigned long simulation_run(Simulation *sim) {
+    if (sim->config.event_mode) return run_event_simulation(sim);
 
-    // Initialize time arrays
-    memset(wait_time_a, 0, sizeof(wait_time_a));
-    memset(wait_time_b, 0, sizeof(wait_time_b));
-    memset(ferry_time_a, 0, sizeof(ferry_time_a));
-    memset(ferry_time_b, 0, sizeof(ferry_time_b));
-    memset(round_trip_time, 0, sizeof(round_trip_time));
+    // Actor runtime: one worker per core, all vehicles start runnable
+    pthread_t ferry_threads[MAX_FERRIES], printer_thread, controller_thread;
+    FerryThread ferry_args[MAX_FERRIES];
+    sim->worker_count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (sim->worker_count < 1) sim->worker_count = 1;
+    pthread_t *worker_threads = malloc(sizeof(pthread_t) * sim->worker_count);
+    for (int i = 0; i < sim->total_vehicles; i++) actor_wake(sim, i);
+    queue_fleet(sim);
+    trace_thread_exit(sim); // This thread traces nothing else
+    publish_snapshot(sim, 1);
 
-    // Create threads
-    pthread_create(&ferry_thread, NULL, ferry_func, NULL);
-    pthread_create(&printer_thread, NULL, print_state_thread, NULL);
-    for (int i = 0; i < TOTAL_VEHICLES; i++)
-        pthread_create(&vehicle_threads[i], NULL, vehicle_func, &vehicles[i]);
+    for (int k = 0; k < sim->ferry_count; k++) {
+        ferry_args[k] = (FerryThread){sim, &sim->ferries[k]};
+        pthread_create(&ferry_threads[k], NULL, ferry_func, &ferry_args[k]);
+    }
+    pthread_create(&printer_thread, NULL, print_state_thread, sim);
+    if (sim->config.toll_autoscale) pthread_create(&controller_thread, NULL, plaza_thread, sim);
+    for (int i = 0; i < sim->worker_count; i++)
+        pthread_create(&worker_threads[i], NULL, worker_func, sim);
 
-    // Join threads
-    for (int i = 0; i < TOTAL_VEHICLES; i++)
-        pthread_join(vehicle_threads[i], NULL);
-    pthread_join(ferry_thread, NULL);
+    for (int k = 0; k < sim->ferry_count; k++) pthread_join(ferry_threads[k], NULL);
+    stop_actor_runtime(sim);
+    for (int i = 0; i < sim->worker_count; i++)
+        pthread_join(worker_threads[i], NULL);
+    free(worker_threads);
+    print_trip_summary(sim);
     pthread_join(printer_thread, NULL);
+    if (sim->config.toll_autoscale) pthread_join(controller_thread, NULL);
+    return 0;
+}
+
+void simulation_destroy(Simulation *sim) {
+    trace_close(sim);
+    for (int i = 0; i < 2 * sim->config.toll_per_side; i++) pthread_mutex_destroy(&sim->booths[i].mutex);
+    for (int side = 0; side < 2; side++) {
+        free(sim->side_reach[side].bits);
+        free(sim->gate_reach[side].bits);
+        free(sim->resting[side]);
+    }
+    pthread_mutex_destroy(&sim->boarding_mutex);
+    pthread_mutex_destroy(&sim->return_mutex);
+    pthread_mutex_destroy(&sim->log_mutex);
+    pthread_mutex_destroy(&sim->sched_mutex);
+    for (int k = 0; k < sim->ferry_count; k++) {
+        pthread_cond_destroy(&sim->ferries[k].full);
+        free(sim->ferries[k].boarded_ids);
+    }
+    free(sim->ferries);
+    pthread_cond_destroy(&sim->sched_cond);
+    free(sim->vehicles);
+    free(sim->records);
+    free(sim->planner_prefix);
+    free(sim->planner_wait);
+    free(sim->planner_take);
+    free(sim->planner_pick);
+    free(sim->wait_time_a);
+    free(sim->wait_time_b);
+    free(sim->ferry_time_a);
+    free(sim->ferry_time_b);
+    free(sim->round_trip_time);
+    free(sim->latency);
+    free(sim->booths);
+    free(sim->actor_timers);
+#ifdef LOCK_PROFILE
+    free(sim->lock_profile);
+#endif
+    free_trip_log(sim);
+    free(sim);
+}
+
+// Batch mode (--batch SPEC): a parameter sweep of event-mode runs. Each run is
+// its own Simulation, so runs need no locking between them; one worker thread
+// per core takes the next run until none are left.
+// The spec has one key=start[:end[:step]] line per swept parameter (vehicles,
+// capacity, tolls, checks) plus seeds=N; every combination runs N times, with
+// replicate s seeded from the base seed plus s. Everything else, and the class
+// mix the vehicle count is split by, comes from the base configuration; a
+// capacity sweep only sizes the lone ferry, not a fleet given by FERRY lines.
+typedef struct {
+    int vehicles, capacity, tolls, checks;
+    uint64_t seed;
+} BatchRun;
+
+typedef struct {
+    int completed; // Every vehicle made its round-trip
+    int trips, empty_trips;
+    double utilization;
+    LatencyHistogram wait; // Wait at A plus wait at B, every vehicle
+    double booth_hours; // Toll staffing cost
+} BatchResult;
+
+typedef struct {
+    const SimConfig *base;
+    BatchRun *runs;
+    BatchResult *results;
+    int total;
+    int next; // Next run to hand out
+} BatchQueue;
+
+// start[:end[:step]]; returns -1 unless value is exactly that
+int parse_sweep_range(const char *value, int range[3]) {
+    int r[3] = {0, 0, 1}, end[3];
+    int fields = sscanf(value, "%d%n:%d%n:%d%n", &r[0], &end[0], &r[1], &end[1], &r[2], &end[2]);
+    if (fields < 1 || value[end[fields - 1]] != '\0' || r[2] < 1) return -1;
+    if (fields == 1) r[1] = r[0];
+    memcpy(range, r, sizeof(r));
+    return 0;
+}
+
+void run_batch_one(const SimConfig *base, BatchRun *run, BatchResult *result) {
+    SimConfig config = *base;
+    config_scale_vehicles(&config, run->vehicles);
+    config.ferry_capacity = run->capacity;
+    config.toll_per_side = run->tolls;
+    config.max_ferry_checks = run->checks;
+    config.seed = run->seed;
+    config.event_mode = 1;
+    config.vehicle_table = 0;
+    Simulation *sim = simulation_create(&config);
+    simulation_run(sim);
+
+    double used = 0, room = 0;
+    for (int i = 0; i < sim->trip_count; i++) {
+        used += sim->trip_log[i].capacity_used;
+        room += trip_capacity(sim, &sim->trip_log[i]);
+        if (sim->trip_log[i].vehicle_count == 0) result->empty_trips++;
+    }
+    result->wait = latency_total(sim, LAT_TOTAL_WAIT);
+    result->trips = sim->trip_count;
+    result->booth_hours = booth_hours(sim);
+    result->utilization = room > 0 ? used / room : 0;
+    result->completed = sim->total_returned == sim->total_vehicles;
+    simulation_destroy(sim);
+}
+
+void* batch_worker(void* arg) {
+    BatchQueue *q = arg;
+    int k;
+    while ((k = __atomic_fetch_add(&q->next, 1, __ATOMIC_RELAXED)) < q->total)
+        run_batch_one(q->base, &q->runs[k], &q->results[k]);
+    return NULL;
+}
+
+int run_batch(const char *spec_path, const SimConfig *base) {
+    // Sweep ranges: vehicles, capacity, tolls, checks
+    int vehicles = config_vehicle_count(base), largest = 1;
+    int range[4][3] = {{vehicles, vehicles, 1}, {base->ferry_capacity, base->ferry_capacity, 1},
+                       {base->toll_per_side, base->toll_per_side, 1}, {base->max_ferry_checks, base->max_ferry_checks, 1}};
+    uint64_t seed = base->seed;
+    for (int c = 0; c < base->class_count; c++)
+        if (base->classes[c].capacity > largest) largest = base->classes[c].capacity;
+    const char *keys[4] = {"vehicles", "capacity", "tolls", "checks"};
+    int seeds = 1;
+    FILE *fp = fopen(spec_path, "r");
+    if (!fp) {
+        fprintf(stderr, "Error: Could not open sweep spec %s.\n", spec_path);
+        return 1;
+    }
+    // Same line rules as load_config; a key that isn't swept or a malformed range is an error
+    char line[128], pair[128];
+    int line_no = 0, bad = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        line_no++;
+        line[strcspn(line, "#\r\n")] = '\0';
+        char *key = line + strspn(line, " \t"), *value = strchr(key, '='), *end;
+        if (!*key) continue;
+        strcpy(pair, key);
+        int ok = 0;
+        if (value) {
+            *value++ = '\0';
+            for (int k = 0; k < 4; k++)
+                if (strcmp(key, keys[k]) == 0) ok = parse_sweep_range(value, range[k]) == 0;
+            if (strcmp(key, "seeds") == 0) {
+                long n = strtol(value, &end, 10);
+                ok = end != value && *end == '\0' && n >= 1 && n <= INT_MAX;
+                if (ok) seeds = (int)n;
+            }
+        }
+        if (!ok) {
+            fprintf(stderr, "Error: %s:%d: bad sweep line '%s'.\n", spec_path, line_no, pair);
+            bad = 1;
+        }
+    }
+    fclose(fp);
+    if (bad) return 1;
+    if (seeds < 1 || range[0][0] < 1 || range[1][0] < largest || range[2][0] < 1 || range[3][0] < 0) {
+        fprintf(stderr, "Error: sweep needs vehicles >= 1, capacity >= %d (the largest class), tolls >= 1, seeds >= 1.\n",
+                largest);
+        return 1;
+    }
+
+    int steps[4], combos = 1;
+    for (int k = 0; k < 4; k++) {
+        steps[k] = range[k][1] >= range[k][0] ? (int)(((long)range[k][1] - range[k][0]) / range[k][2] + 1) : 1;
+        if (combos > INT_MAX / steps[k]) combos = 0;
+        else if (combos) combos *= steps[k];
+    }
+    if (!combos || seeds > INT_MAX / combos) {
+        fprintf(stderr, "Error: sweep of %s has too many runs.\n", spec_path);
+        return 1;
+    }
+    int total = combos * seeds;
+    BatchRun *runs = malloc(sizeof(BatchRun) * total);
+    BatchResult *results = calloc(total, sizeof(BatchResult));
+    if (!runs || !results) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+    for (int c = 0; c < combos; c++) {
+        int rest = c, value[4];
+        for (int k = 3; k >= 0; k--) {
+            value[k] = range[k][0] + (rest % steps[k]) * range[k][2];
+            rest /= steps[k];
+        }
+        for (int s = 0; s < seeds; s++)
+            runs[c * seeds + s] = (BatchRun){value[0], value[1], value[2], value[3], seed + s};
+    }
+
+    int jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    if (jobs < 1) jobs = 1;
+    if (jobs > total) jobs = total;
+    BatchQueue queue = {base, runs, results, total, 0};
+    pthread_t *workers = malloc(sizeof(pthread_t) * jobs);
+    struct timespec started, finished;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    for (int i = 0; i < jobs; i++) pthread_create(&workers[i], NULL, batch_worker, &queue);
+    for (int i = 0; i < jobs; i++) pthread_join(workers[i], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &finished);
+    free(workers);
+
+    printf("\n\033[1m┏━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━ Batch Sweep ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━┓\n");
+    printf("┃ Vehicles | Capacity | Tolls | Checks | Runs | Util %%  | Empty %% | Mean Wait | p99 Wait | Booth-h ┃\n");
+    printf("┣━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━┫\033[0m\n");
+    int failed = 0;
+    for (int c = 0; c < combos; c++) {
+        BatchRun *run = &runs[c * seeds];
+        int ok = 0, trips = 0, empty = 0;
+        double utilization = 0, hours = 0;
+        LatencyHistogram wait = {0}; // Pooled over the seeds
+        for (int s = 0; s < seeds; s++) {
+            BatchResult *r = &results[c * seeds + s];
+            if (!r->completed) {
+                failed++;
+                continue;
+            }
+            ok++;
+            trips += r->trips;
+            empty += r->empty_trips;
+            utilization += r->utilization;
+            hours += r->booth_hours;
+            hist_merge(&wait, &r->wait);
+        }
+        printf("┃ %8d | %8d | %5d | %6d | %4d | %6.2f%% | %6.2f%% | %8.2fs | %7.2fs | %7.3f ┃\n",
+               run->vehicles, run->capacity, run->tolls, run->checks, ok,
+               ok ? utilization / ok * 100 : 0, trips ? empty * 100.0 / trips : 0,
+               hist_mean(&wait), hist_percentile(&wait, 0.99), ok ? hours / ok : 0);
+    }
+    double elapsed = (finished.tv_sec - started.tv_sec) + (finished.tv_nsec - started.tv_nsec) / 1e9;
+    printf("\033[1m┗━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━┛\033[0m\n");
+    printf("%d runs on %d cores in %.2fs (%.0f runs/s), base seed %llu\n", total, jobs, elapsed,
+           total / elapsed, (unsigned long long)seed);
+    if (failed) printf("%d runs did not complete and are left out\n", failed);
 
-    // Print final statistics
-    show_final_statistics();
+    free(runs);
+    free(results);
+    return 0;
+}
+
+int trip_id_order(const void *a, const void *b) {
+    return ((const Trip *)a)->trip_id - ((const Trip *)b)->trip_id;
+}
+
+// Rebuild a run from its trace and write the usual ferry_log.txt and ferry_log.json.
+// Each vessel's events come from one thread and are in order; per-vehicle times
+// may be interleaved with them arbitrarily, so they are collected first and
+// combined at the end. Trips are logged as they end and sorted by id afterwards.
+int convert_trace(Simulation *sim, const char *path) {
+    TraceReader r;
+    if (trace_map(&r, path) < 0 || r.header->vehicles != sim->total_vehicles ||
+        r.header->ferry_capacity != sim->config.ferry_capacity ||
+        (r.header->ferries ? r.header->ferries : 1) != sim->ferry_count) {
+        fprintf(stderr, "Error: %s is not a trace of this simulation.\n", path);
+        return 1;
+    }
+    double (*toll_start)[2] = calloc(sim->total_vehicles, sizeof(double[2]));
+    double (*board_time)[2] = calloc(sim->total_vehicles, sizeof(double[2]));
+    double (*unload_time)[2] = calloc(sim->total_vehicles, sizeof(double[2]));
+    sim->config.event_mode = 1; // Reports read the virtual clock
+    sim->sim_start_time = r.header->start_time;
+
+    Trip departure[MAX_FERRIES] = {{0}};
+    int departed[MAX_FERRIES] = {0};
+    double arrived[MAX_FERRIES]; // Time of the last TR_ARRIVE, -1 once docked
+    for (int k = 0; k < MAX_FERRIES; k++) arrived[k] = -1;
+    long events = 0;
+    for (long k = 0; k < r.count; k++) {
+        TraceRecord *e = &r.records[k];
+        int i = e->vehicle - 1;
+        if (e->type == 0 || e->ferry >= sim->ferry_count) continue;
+        Ferry *f = &sim->ferries[e->ferry];
+        events++;
+        if (e->time > sim->sim_clock) sim->sim_clock = e->time;
+        switch (e->type) {
+            case TR_TOLL_START:
+                toll_start[i][e->side] = e->time;
+                break;
+            case TR_BOARD:
+                board_time[i][e->side] = e->time;
+                if (f->boarded_count < f->spec.capacity) f->boarded_ids[f->boarded_count++] = e->vehicle;
+                break;
+            case TR_UNLOAD:
+                unload_time[i][1 - e->side] = e->time;
+                break;
+            case TR_RETURNED:
+                record_vehicle_time(sim, &sim->vehicles[i], LAT_ROUND_TRIP, sim->records[i].start_port, llround(e->time * 1e9));
+                sim->total_returned++;
+                break;
+            case TR_DEPART:
+                departure[e->ferry] = (Trip){.trip_id = e->trip, .direction = e->side, .duration = e->time,
+                                             .capacity_used = e->load, .fcfs_capacity = e->aux};
+                departed[e->ferry] = 1;
+                break;
+            case TR_ARRIVE:
+            case TR_DOCK: // Traces from before berths have no TR_ARRIVE
+                if (e->type == TR_ARRIVE) arrived[e->ferry] = e->time;
+                else if (arrived[e->ferry] >= 0) {
+                    f->berth_wait_ns += llround((e->time - arrived[e->ferry]) * 1e9);
+                    arrived[e->ferry] = -1;
+                }
+                if (!departed[e->ferry]) break;
+                f->trip_id = departure[e->ferry].trip_id;
+                f->side = departure[e->ferry].direction;
+                f->load = departure[e->ferry].capacity_used;
+                log_trip(sim, f, e->time - departure[e->ferry].duration, departure[e->ferry].fcfs_capacity);
+                f->boarded_count = 0;
+                departed[e->ferry] = 0;
+                break;
+        }
+    }
+    // Vessels still crossing when everyone was home: their trips run to the end of the trace
+    for (int k = 0; k < sim->ferry_count; k++) {
+        if (!departed[k]) continue;
+        Ferry *f = &sim->ferries[k];
+        f->trip_id = departure[k].trip_id;
+        f->side = departure[k].direction;
+        f->load = departure[k].capacity_used;
+        log_trip(sim, f, sim->sim_clock - departure[k].duration, departure[k].fcfs_capacity);
+    }
+    qsort(sim->trip_log, sim->trip_count, sizeof(Trip), trip_id_order);
+    for (int i = 0; i < sim->total_vehicles; i++) {
+        Vehicle *v = &sim->vehicles[i];
+        double total_wait = 0;
+        for (int side = 0; side < 2; side++) {
+            if (board_time[i][side] <= 0) continue;
+            total_wait += board_time[i][side] - toll_start[i][side];
+            record_vehicle_time(sim, v, LAT_WAIT, side, llround((board_time[i][side] - toll_start[i][side]) * 1e9));
+            record_vehicle_time(sim, v, LAT_CROSSING, side, llround((unload_time[i][side] - board_time[i][side]) * 1e9));
+        }
+        if (board_time[i][SIDE_B] > 0) record_vehicle_time(sim, v, LAT_TOTAL_WAIT, sim->records[i].start_port, llround(total_wait * 1e9));
+    }
+    latency_thread_exit(sim);
+    trace_unmap(&r);
+    free(toll_start);
+    free(board_time);
+    free(unload_time);
+
+    write_log_file(sim);
+    write_json_log(sim);
+    printf("Converted %ld events (%d trips, %d/%d vehicles returned) to ferry_log.txt and ferry_log.json\n",
+           events, sim->trip_count, sim->total_returned, sim->total_vehicles);
+    return 0;
+}
+
+// ferry_bench.c includes this file with FERRY_NO_MAIN to reach its internals
+#ifndef FERRY_NO_MAIN
+int main(int argc, char *argv[]) {
+    SimConfig config = default_config;
+    const char *trace_path = NULL, *convert_path = NULL, *batch_path = NULL;
+    int headless = 0; // Event engine, final statistics and log files only
+    config.seed = time(NULL);
+    // The config file comes first wherever it is given, so the command line overrides it
+    for (int i = 1; i + 1 < argc; i++)
+        if (strcmp(argv[i], "--config") == 0 && load_config(&config, argv[++i]) < 0) return 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--event") == 0) config.event_mode = 1;
+        else if (strcmp(argv[i], "--headless") == 0) config.event_mode = headless = 1;
+        else if (strcmp(argv[i], "--config") == 0 && i + 1 < argc) i++;
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) trace_path = argv[++i];
+        else if (strcmp(argv[i], "--convert-trace") == 0 && i + 1 < argc) convert_path = argv[++i];
+        else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) batch_path = argv[++i];
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) config.seed = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--set") == 0 && i + 1 < argc) {
+            if (config_set_pair(&config, argv[++i]) < 0) {
+                fprintf(stderr, "Error: bad setting '%s'.\n", argv[i]);
+                return 1;
+            }
+        }
+    }
+    if (config_check(&config) < 0) return 1;
+
+    if (batch_path) return run_batch(batch_path, &config);
+
+    Simulation *sim = simulation_create(&config);
+    if (convert_path) {
+        int status = convert_trace(sim, convert_path);
+        simulation_destroy(sim);
+        return status;
+    }
+    if (trace_path && trace_open(sim, trace_path) < 0) {
+        fprintf(stderr, "Error: Could not open %s for writing.\n", trace_path);
+        simulation_destroy(sim);
+        return 1;
+    }
 
-    // Cleanup
-    for (int i = 0; i < 4; i++) sem_destroy(&toll_sem[i]);
-    pthread_mutex_destroy(&boarding_mutex);
-    pthread_mutex_destroy(&return_mutex);
-    pthread_mutex_destroy(&log_mutex);
-    pthread_mutex_destroy(&print_mutex);
+    unsigned long processed = simulation_run(sim);
+    if (config.event_mode && !headless) {
+        printf("\033[36m⛴️ Event mode: %lu events, %.2f simulated seconds, seed %llu\033[0m\n", processed,
+               sim->sim_clock, (unsigned long long)config.seed);
+        print_trip_summary(sim);
+    }
+    show_final_statistics(sim);
+    simulation_destroy(sim);
 
-    printf("\n\033[1m✅ Simulation completed. Log saved to ferry_log.txt.\033[0m\n");
+    printf("\n\033[1m✅ Simulation completed. Logs saved to ferry_log.txt and ferry_log.json.\033[0m\n");
     return 0;
-}
\ No newline at end of file
+}
+#endif
@@ -5,81 +5,104 @@
 #include <unistd.h>
 #include <time.h>
 #include <string.h>
+#include <fcntl.h>
 #include <ncurses.h>
 #include <math.h>
 
-// cJSON kütüphanesi (gömülü)
-typedef struct cJSON {
-    struct cJSON *next, *prev, *child;
-    int type;
-    char *valuestring;
-    int valueint;
-    double valuedouble;
-    char *string;
-} cJSON;
-
-#define cJSON_Object 4
-#define cJSON_Array 5
-#define cJSON_String 6
-#define cJSON_Number 7
-
-// cJSON fonksiyon prototipleri
-cJSON *cJSON_CreateObject(void);
-cJSON *cJSON_CreateArray(void);
-cJSON *cJSON_CreateString(const char *string);
-cJSON *cJSON_CreateNumber(double num);
-void cJSON_AddItemToObject(cJSON *object, const char *string, cJSON *item);
-void cJSON_AddItemToArray(cJSON *array, cJSON *item);
-void cJSON_AddNumberToObject(cJSON *object, const char *string, double num);
-void cJSON_AddStringToObject(cJSON *object, const char *string, const char *value);
-void cJSON_Delete(cJSON *c);
-char *cJSON_Print(cJSON *item);
-
-// cJSON fonksiyon tanımları
-cJSON *cJSON_CreateObject(void) { cJSON *item = (cJSON*)calloc(1, sizeof(cJSON)); item->type = cJSON_Object; return item; }
-cJSON *cJSON_CreateArray(void) { cJSON *item = (cJSON*)calloc(1, sizeof(cJSON)); item->type = cJSON_Array; return item; }
-cJSON *cJSON_CreateString(const char *string) { cJSON *item = (cJSON*)calloc(1, sizeof(cJSON)); item->type = cJSON_String; item->valuestring = strdup(string); return item; }
-cJSON *cJSON_CreateNumber(double num) { cJSON *item = (cJSON*)calloc(1, sizeof(cJSON)); item->type = cJSON_Number; item->valuedouble = num; item->valueint = (int)num; return item; }
-void cJSON_AddItemToObject(cJSON *object, const char *string, cJSON *item) { item->string = strdup(string); item->next = object->child; if (object->child) object->child->prev = item; object->child = item; }
-void cJSON_AddItemToArray(cJSON *array, cJSON *item) { cJSON *c = array->child; if (!c) { array->child = item; } else { while (c->next) c = c->next; c->next = item; item->prev = c; } }
-void cJSON_AddNumberToObject(cJSON *object, const char *string, double num) { cJSON *item = cJSON_CreateNumber(num); cJSON_AddItemToObject(object, string, item); }
-void cJSON_AddStringToObject(cJSON *object, const char *string, const char *value) { cJSON *item = cJSON_CreateString(value); cJSON_AddItemToObject(object, string, item); }
-void cJSON_Delete(cJSON *c) { cJSON *next; while (c) { next = c->next; if (c->child) cJSON_Delete(c->child); if (c->valuestring) free(c->valuestring); if (c->string) free(c->string); free(c); c = next; } }
-char *cJSON_Print(cJSON *item) {
-    char *buf = (char*)malloc(1024); buf[0] = '\0'; int len = 1024;
-    if (item->type == cJSON_Object) {
-        sprintf(buf, "{"); cJSON *c = item->child;
-        while (c) {
-            char *child = cJSON_Print(c); char *key = c->string;
-            len += strlen(key) + strlen(child) + 5;
-            buf = (char*)realloc(buf, len);
-            strcat(buf, "\""); strcat(buf, key); strcat(buf, "\":"); strcat(buf, child);
-            if (c->next) strcat(buf, ",");
-            free(child); c = c->next;
-        }
-        strcat(buf, "}");
-    } else if (item->type == cJSON_Array) {
-        sprintf(buf, "["); cJSON *c = item->child;
-        while (c) {
-            char *child = cJSON_Print(c);
-            len += strlen(child) + 2;
-            buf = (char*)realloc(buf, len);
-            strcat(buf, child);
-            if (c->next) strcat(buf, ",");
-            free(child); c = c->next;
+// Streaming JSON writer (embedded): values go straight into a small buffer that
+// is flushed to the file descriptor when full, so no document tree is built and
+// memory stays constant whatever the log size
+typedef struct {
+    int fd;
+    int len;
+    int depth;
+    unsigned first; // Bit d set: nothing written yet at nesting depth d
+    char buf[8192];
+} JsonWriter;
+
+void json_flush(JsonWriter *w) {
+    for (int off = 0; off < w->len; ) {
+        ssize_t n = write(w->fd, w->buf + off, w->len - off);
+        if (n <= 0) break;
+        off += n;
+    }
+    w->len = 0;
+}
+
+void json_put(JsonWriter *w, const char *s, int n) {
+    while (n > 0) {
+        if (w->len == (int)sizeof(w->buf)) json_flush(w);
+        int chunk = (int)sizeof(w->buf) - w->len;
+        if (chunk > n) chunk = n;
+        memcpy(w->buf + w->len, s, chunk);
+        w->len += chunk;
+        s += chunk;
+        n -= chunk;
+    }
+}
+
+void json_put_string(JsonWriter *w, const char *s) {
+    json_put(w, "\"", 1);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') {
+            char esc[2] = {'\\', *s};
+            json_put(w, esc, 2);
+        } else if ((unsigned char)*s < 0x20) {
+            char esc[8];
+            json_put(w, esc, sprintf(esc, "\\u%04x", *s));
+        } else {
+            json_put(w, s, 1);
         }
-        strcat(buf, "]");
-    } else if (item->type == cJSON_String) {
-        len += strlen(item->valuestring) + 3;
-        buf = (char*)realloc(buf, len);
-        sprintf(buf, "\"%s\"", item->valuestring);
-    } else if (item->type == cJSON_Number) {
-        char tmp[32]; sprintf(tmp, "%.2f", item->valuedouble);
-        len += strlen(tmp) + 1;
-        buf = (char*)realloc(buf, len);
-        strcpy(buf, tmp);
     }
-    return buf;
+    json_put(w, "\"", 1);
+}
+
+// Separator and key for the next value; key is NULL inside arrays
+void json_key(JsonWriter *w, const char *key) {
+    if (!(w->first & (1u << w->depth))) json_put(w, ",", 1);
+    w->first &= ~(1u << w->depth);
+    if (key) {
+        json_put_string(w, key);
+        json_put(w, ":", 1);
+    }
+}
+
+void json_number(JsonWriter *w, const char *key, double num) {
+    char tmp[32];
+    json_key(w, key);
+    json_put(w, tmp, sprintf(tmp, "%.2f", num));
+}
+
+void json_string(JsonWriter *w, const char *key, const char *value) {
+    json_key(w, key);
+    json_put_string(w, value);
+}
+
+// open is '{' or '['
+void json_begin(JsonWriter *w, const char *key, char open) {
+    json_key(w, key);
+    json_put(w, &open, 1);
+    w->depth++;
+    w->first |= 1u << w->depth;
+}
+
+void json_end(JsonWriter *w, char close) {
+    w->depth--;
+    json_put(w, &close, 1);
+}
+
+int json_open(JsonWriter *w, const char *path) {
+    w->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    w->len = 0;
+    w->depth = 0;
+    w->first = 1;
+    return w->fd < 0 ? -1 : 0;
+}
+
+void json_close(JsonWriter *w) {
+    json_put(w, "\n", 1);
+    json_flush(w);
+    close(w->fd);
 }
 
 #define CAR_COUNT 25
@@ -300,61 +323,56 @@ void print_state(int wait_counter) {
 }
 
 void write_log_file() {
-    cJSON *root = cJSON_CreateObject();
-    cJSON *trips = cJSON_CreateArray();
-    cJSON *vehicles_array = cJSON_CreateArray();
+    JsonWriter w;
+    if (json_open(&w, "ferry_log.json") < 0) return;
 
-    cJSON_AddNumberToObject(root, "total_vehicles", TOTAL_VEHICLES);
-    cJSON_AddNumberToObject(root, "ferry_capacity", FERRY_CAPACITY);
-    cJSON_AddNumberToObject(root, "total_trips", trip_count);
-    cJSON_AddNumberToObject(root, "duration", (double)(time(NULL) - sim_start_time));
+    json_begin(&w, NULL, '{');
+    json_number(&w, "total_vehicles", TOTAL_VEHICLES);
+    json_number(&w, "ferry_capacity", FERRY_CAPACITY);
+    json_number(&w, "total_trips", trip_count);
+    json_number(&w, "duration", (double)(time(NULL) - sim_start_time));
 
+    json_begin(&w, "trips", '[');
     for (int i = 0; i < trip_count; i++) {
-        cJSON *trip = cJSON_CreateObject();
         Trip *t = &trip_log[i];
-        cJSON_AddNumberToObject(trip, "id", t->trip_id);
-        cJSON_AddStringToObject(trip, "direction", t->direction == SIDE_X ? "X->Y" : "Y->X");
-        cJSON_AddNumberToObject(trip, "duration", t->duration);
-        cJSON_AddNumberToObject(trip, "capacity_used", t->capacity_used);
-        cJSON_AddNumberToObject(trip, "capacity_percent", (t->capacity_used / (float)FERRY_CAPACITY) * 100);
-        cJSON *vehicles_json = cJSON_CreateArray();
+        json_begin(&w, NULL, '{');
+        json_number(&w, "id", t->trip_id);
+        json_string(&w, "direction", t->direction == SIDE_X ? "X->Y" : "Y->X");
+        json_number(&w, "duration", t->duration);
+        json_number(&w, "capacity_used", t->capacity_used);
+        json_number(&w, "capacity_percent", (t->capacity_used / (float)FERRY_CAPACITY) * 100);
+        json_begin(&w, "vehicles", '[');
         for (int j = 0; j < t->vehicle_count; j++) {
             for (int k = 0; k < TOTAL_VEHICLES; k++) {
                 if (vehicles[k].id == t->vehicle_ids[j]) {
                     char buf[32];
                     sprintf(buf, "%s%d", get_type_name(vehicles[k].type), t->vehicle_ids[j]);
-                    cJSON_AddItemToArray(vehicles_json, cJSON_CreateString(buf));
+                    json_string(&w, NULL, buf);
                     break;
                 }
             }
         }
-        cJSON_AddItemToObject(trip, "vehicles", vehicles_json);
-        cJSON_AddItemToArray(trips, trip);
+        json_end(&w, ']');
+        json_end(&w, '}');
     }
-    cJSON_AddItemToObject(root, "trips", trips);
+    json_end(&w, ']');
 
+    json_begin(&w, "vehicles", '[');
     for (int i = 0; i < TOTAL_VEHICLES; i++) {
-        cJSON *veh = cJSON_CreateObject();
-        cJSON_AddNumberToObject(veh, "id", vehicles[i].id);
-        cJSON_AddStringToObject(veh, "type", get_type_name(vehicles[i].type));
-        cJSON_AddStringToObject(veh, "start", vehicles[i].start_port == SIDE_X ? "X" : "Y");
-        cJSON_AddNumberToObject(veh, "wait_x", wait_time_x[i]);
-        cJSON_AddNumberToObject(veh, "wait_y", wait_time_y[i]);
-        cJSON_AddNumberToObject(veh, "ferry_x", ferry_time_x[i]);
-        cJSON_AddNumberToObject(veh, "ferry_y", ferry_time_y[i]);
-        cJSON_AddNumberToObject(veh, "round_trip", round_trip_time[i]);
-        cJSON_AddItemToArray(vehicles_array, veh);
-    }
-    cJSON_AddItemToObject(root, "vehicles", vehicles_array);
-
-    char *json_str = cJSON_Print(root);
-    FILE *fp = fopen("ferry_log.json", "w");
-    if (fp) {
-        fprintf(fp, "%s\n", json_str);
-        fclose(fp);
+        json_begin(&w, NULL, '{');
+        json_number(&w, "id", vehicles[i].id);
+        json_string(&w, "type", get_type_name(vehicles[i].type));
+        json_string(&w, "start", vehicles[i].start_port == SIDE_X ? "X" : "Y");
+        json_number(&w, "wait_x", wait_time_x[i]);
+        json_number(&w, "wait_y", wait_time_y[i]);
+        json_number(&w, "ferry_x", ferry_time_x[i]);
+        json_number(&w, "ferry_y", ferry_time_y[i]);
+        json_number(&w, "round_trip", round_trip_time[i]);
+        json_end(&w, '}');
     }
-    free(json_str);
-    cJSON_Delete(root);
+    json_end(&w, ']');
+    json_end(&w, '}');
+    json_close(&w);
 }
 
 void show_final_statistics() {
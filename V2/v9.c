@@ -5,68 +5,107 @@
 #include <unistd.h>
 #include <time.h>
 #include <string.h>
-#include <ncurses.h>
+#include <fcntl.h>
+#include <stdarg.h>
 #include <math.h>
+#ifndef HEADLESS
+#include <ncurses.h>
+#endif
 
-// cJSON kütüphanesi (gömülü)
-typedef struct cJSON {
-    struct cJSON *next, *prev, *child;
-    int type;
-    char *valuestring;
-    int valueint;
-    double valuedouble;
-    char *string;
-} cJSON;
-
-#define cJSON_Object 4
-#define cJSON_Array 5
-#define cJSON_String 6
-#define cJSON_Number 7
-
-cJSON *cJSON_CreateObject(void) { cJSON *item = (cJSON*)calloc(1, sizeof(cJSON)); item->type = cJSON_Object; return item; }
-cJSON *cJSON_CreateArray(void) { cJSON *item = (cJSON*)calloc(1, sizeof(cJSON)); item->type = cJSON_Array; return item; }
-cJSON *cJSON_CreateString(const char *string) { cJSON *item = (cJSON*)calloc(1, sizeof(cJSON)); item->type = cJSON_String; item->valuestring = strdup(string); return item; }
-cJSON *cJSON_CreateNumber(double num) { cJSON *item = (cJSON*)calloc(1, sizeof(cJSON)); item->type = cJSON_Number; item->valuedouble = num; item->valueint = (int)num; return item; }
-void cJSON_AddItemToObject(cJSON *object, const char *string, cJSON *item) { item->string = strdup(string); item->next = object->child; if (object->child) object->child->prev = item; object->child = item; }
-void cJSON_AddItemToArray(cJSON *array, cJSON *item) { cJSON *c = array->child; if (!c) { array->child = item; } else { while (c->next) c = c->next; c->next = item; item->prev = c; } }
-void cJSON_AddNumberToObject(cJSON *object, const char *string, double num) { cJSON *item = cJSON_CreateNumber(num); cJSON_AddItemToObject(object, string, item); }
-void cJSON_AddStringToObject(cJSON *object, const char *string, const char *value) { cJSON *item = cJSON_CreateString(value); cJSON_AddItemToObject(object, string, item); }
-void cJSON_Delete(cJSON *c) { cJSON *next; while (c) { next = c->next; if (c->child) cJSON_Delete(c->child); if (c->valuestring) free(c->valuestring); if (c->string) free(c->string); free(c); c = next; } }
-char *cJSON_Print(cJSON *item) {
-    char *buf = (char*)malloc(1024); buf[0] = '\0'; int len = 1024;
-    if (item->type == cJSON_Object) {
-        sprintf(buf, "{"); cJSON *c = item->child;
-        while (c) {
-            char *child = cJSON_Print(c); char *key = c->string;
-            len += strlen(key) + strlen(child) + 5;
-            buf = (char*)realloc(buf, len);
-            strcat(buf, "\""); strcat(buf, key); strcat(buf, "\":"); strcat(buf, child);
-            if (c->next) strcat(buf, ",");
-            free(child); c = c->next;
-        }
-        strcat(buf, "}");
-    } else if (item->type == cJSON_Array) {
-        sprintf(buf, "["); cJSON *c = item->child;
-        while (c) {
-            char *child = cJSON_Print(c);
-            len += strlen(child) + 2;
-            buf = (char*)realloc(buf, len);
-            strcat(buf, child);
-            if (c->next) strcat(buf, ",");
-            free(child); c = c->next;
+// Streaming JSON writer (embedded): values go straight into a small buffer that
+// is flushed to the file descriptor when full, so no document tree is built and
+// memory stays constant whatever the log size
+typedef struct {
+    int fd;
+    int len;
+    int depth;
+    unsigned first; // Bit d set: nothing written yet at nesting depth d
+    char buf[8192];
+} JsonWriter;
+
+void json_flush(JsonWriter *w) {
+    for (int off = 0; off < w->len; ) {
+        ssize_t n = write(w->fd, w->buf + off, w->len - off);
+        if (n <= 0) break;
+        off += n;
+    }
+    w->len = 0;
+}
+
+void json_put(JsonWriter *w, const char *s, int n) {
+    while (n > 0) {
+        if (w->len == (int)sizeof(w->buf)) json_flush(w);
+        int chunk = (int)sizeof(w->buf) - w->len;
+        if (chunk > n) chunk = n;
+        memcpy(w->buf + w->len, s, chunk);
+        w->len += chunk;
+        s += chunk;
+        n -= chunk;
+    }
+}
+
+void json_put_string(JsonWriter *w, const char *s) {
+    json_put(w, "\"", 1);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') {
+            char esc[2] = {'\\', *s};
+            json_put(w, esc, 2);
+        } else if ((unsigned char)*s < 0x20) {
+            char esc[8];
+            json_put(w, esc, sprintf(esc, "\\u%04x", *s));
+        } else {
+            json_put(w, s, 1);
         }
-        strcat(buf, "]");
-    } else if (item->type == cJSON_String) {
-        len += strlen(item->valuestring) + 3;
-        buf = (char*)realloc(buf, len);
-        sprintf(buf, "\"%s\"", item->valuestring);
-    } else if (item->type == cJSON_Number) {
-        char tmp[32]; sprintf(tmp, "%.2f", item->valuedouble);
-        len += strlen(tmp) + 1;
-        buf = (char*)realloc(buf, len);
-        strcpy(buf, tmp);
     }
-    return buf;
+    json_put(w, "\"", 1);
+}
+
+// Separator and key for the next value; key is NULL inside arrays
+void json_key(JsonWriter *w, const char *key) {
+    if (!(w->first & (1u << w->depth))) json_put(w, ",", 1);
+    w->first &= ~(1u << w->depth);
+    if (key) {
+        json_put_string(w, key);
+        json_put(w, ":", 1);
+    }
+}
+
+void json_number(JsonWriter *w, const char *key, double num) {
+    char tmp[32];
+    json_key(w, key);
+    json_put(w, tmp, sprintf(tmp, "%.2f", num));
+}
+
+void json_string(JsonWriter *w, const char *key, const char *value) {
+    json_key(w, key);
+    json_put_string(w, value);
+}
+
+// open is '{' or '['
+void json_begin(JsonWriter *w, const char *key, char open) {
+    json_key(w, key);
+    json_put(w, &open, 1);
+    w->depth++;
+    w->first |= 1u << w->depth;
+}
+
+void json_end(JsonWriter *w, char close) {
+    w->depth--;
+    json_put(w, &close, 1);
+}
+
+int json_open(JsonWriter *w, const char *path) {
+    w->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    w->len = 0;
+    w->depth = 0;
+    w->first = 1;
+    return w->fd < 0 ? -1 : 0;
+}
+
+void json_close(JsonWriter *w) {
+    json_put(w, "\n", 1);
+    json_flush(w);
+    close(w->fd);
 }
 
 #define CAR_COUNT 25
@@ -78,6 +117,12 @@ char *cJSON_Print(cJSON *item) {
 #define MAX_TRIPS 100
 #define SIDE_X 0
 #define SIDE_Y 1
+// Headless build (-DHEADLESS, no -lncurses): no windows, no input, no
+// animation, and every sleep divided by this speed factor. Only the final
+// statistics and ferry_log.json come out.
+#ifndef HEADLESS_SPEED
+#define HEADLESS_SPEED 1000.0
+#endif
 
 typedef struct {
     int id;
@@ -99,7 +144,7 @@ typedef struct {
     int trip_id;
     int direction; // 0: X->Y, 1: Y->X
     double duration;
-    int vehicle_ids[20];
+    int vehicle_ids[FERRY_CAPACITY]; // Every vehicle takes at least one unit
     int vehicle_count;
     int capacity_used;
 } Trip;
@@ -114,13 +159,16 @@ int total_returned = 0;
 int current_trip_id = 0;
 int is_first_return = 1;
 int final_trip_done = 0;
-int boarded_ids[20];
+int boarded_ids[FERRY_CAPACITY];
 int boarded_count = 0;
 double wait_time_x[TOTAL_VEHICLES], wait_time_y[TOTAL_VEHICLES];
 double ferry_time_x[TOTAL_VEHICLES], ferry_time_y[TOTAL_VEHICLES];
 double round_trip_time[TOTAL_VEHICLES];
 time_t sim_start_time;
+struct timespec wall_start; // Monotonic start, for the headless clock
+#ifndef HEADLESS
 WINDOW *main_win, *ferry_win, *stats_win, *log_win, *status_win;
+#endif
 int paused = 0;
 float sim_speed = 1.0;
 int max_y, max_x;
@@ -130,6 +178,8 @@ pthread_mutex_t boarding_mutex = PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t return_mutex = PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t print_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t ferry_arrived = PTHREAD_COND_INITIALIZER; // Broadcast with every arrival_epoch bump
+unsigned long arrival_epoch = 0; // Number of completed crossings, guarded by boarding_mutex
 sem_t toll_sem[4];
 sem_t pause_sem;
 
@@ -153,6 +203,47 @@ const char* get_type_icon(int type) {
     }
 }
 
+// Ids are handed out densely from 1 in main, so an id indexes the vehicle table directly
+Vehicle *vehicle_by_id(int id) {
+    return &vehicles[id - 1];
+}
+
+// Simulation time in seconds. Headless runs sleep HEADLESS_SPEED times less
+// than they simulate, so wall time is scaled back up; the interactive build
+// changes speed on the fly and keeps reporting wall time.
+time_t sim_now() {
+#ifdef HEADLESS
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double wall = (now.tv_sec - wall_start.tv_sec) + (now.tv_nsec - wall_start.tv_nsec) / 1e9;
+    return sim_start_time + (time_t)(wall * sim_speed);
+#else
+    return time(NULL);
+#endif
+}
+
+// One timestamped line in the log window, in the given colour pair
+void log_event(int color, const char *fmt, ...) {
+#ifndef HEADLESS
+    time_t now = time(NULL);
+    char time_str[20];
+    strftime(time_str, sizeof(time_str), "%H:%M:%S", localtime(&now));
+    va_list args;
+    va_start(args, fmt);
+    pthread_mutex_lock(&print_mutex);
+    wattron(log_win, COLOR_PAIR(color));
+    wprintw(log_win, "[%s] ", time_str);
+    vw_printw(log_win, fmt, args);
+    wattroff(log_win, COLOR_PAIR(color));
+    wrefresh(log_win);
+    pthread_mutex_unlock(&print_mutex);
+    va_end(args);
+#else
+    (void)color;
+    (void)fmt;
+#endif
+}
+
 int can_fill_remaining(int remaining_capacity) {
     int dp[FERRY_CAPACITY + 1];
     memset(dp, 0, sizeof(dp));
@@ -180,6 +271,7 @@ void log_trip(int direction, double duration, int *ids, int count, int capacity)
     pthread_mutex_unlock(&log_mutex);
 }
 
+#ifndef HEADLESS
 void draw_ferry_animation(int position) {
     pthread_mutex_lock(&print_mutex);
     if (!ferry_win) {
@@ -208,15 +300,11 @@ void draw_ferry_animation(int position) {
     if (boarded_count > 0) {
         int veh_pos = ferry_pos + 7;
         for (int i = 0; i < boarded_count && veh_pos < max_x - 5; i++) {
-            for (int j = 0; j < TOTAL_VEHICLES; j++) {
-                if (vehicles[j].id == boarded_ids[i]) {
-                    wattron(ferry_win, COLOR_PAIR(vehicles[j].type + 1));
-                    mvwprintw(ferry_win, 4, veh_pos, "%s", get_type_icon(vehicles[j].type));
-                    wattroff(ferry_win, COLOR_PAIR(vehicles[j].type + 1));
-                    veh_pos += 4;
-                    break;
-                }
-            }
+            Vehicle *v = vehicle_by_id(boarded_ids[i]);
+            wattron(ferry_win, COLOR_PAIR(v->type + 1));
+            mvwprintw(ferry_win, 4, veh_pos, "%s", get_type_icon(v->type));
+            wattroff(ferry_win, COLOR_PAIR(v->type + 1));
+            veh_pos += 4;
         }
     }
     wattroff(ferry_win, COLOR_PAIR(4));
@@ -228,69 +316,63 @@ void draw_ferry_animation(int position) {
     wrefresh(ferry_win);
     pthread_mutex_unlock(&print_mutex);
 }
+#endif
 
 void write_log_file() {
-    cJSON *root = cJSON_CreateObject();
-    cJSON *trips = cJSON_CreateArray();
-    cJSON *vehicles_array = cJSON_CreateArray();
+    JsonWriter w;
+    if (json_open(&w, "ferry_log.json") < 0) {
+        fprintf(stderr, "Error: Could not open ferry_log.json for writing.\n");
+        return;
+    }
 
-    cJSON_AddNumberToObject(root, "total_vehicles", TOTAL_VEHICLES);
-    cJSON_AddNumberToObject(root, "ferry_capacity", FERRY_CAPACITY);
-    cJSON_AddNumberToObject(root, "total_trips", trip_count);
-    cJSON_AddNumberToObject(root, "duration", difftime(time(NULL), sim_start_time));
+    json_begin(&w, NULL, '{');
+    json_number(&w, "total_vehicles", TOTAL_VEHICLES);
+    json_number(&w, "ferry_capacity", FERRY_CAPACITY);
+    json_number(&w, "total_trips", trip_count);
+    json_number(&w, "duration", difftime(sim_now(), sim_start_time));
 
+    json_begin(&w, "trips", '[');
     for (int i = 0; i < trip_count; i++) {
-        cJSON *trip = cJSON_CreateObject();
         Trip *t = &trip_log[i];
-        cJSON_AddNumberToObject(trip, "id", t->trip_id);
-        cJSON_AddStringToObject(trip, "direction", t->direction == SIDE_X ? "X->Y" : "Y->X");
-        cJSON_AddNumberToObject(trip, "duration", t->duration);
-        cJSON_AddNumberToObject(trip, "capacity_used", t->capacity_used);
-        cJSON_AddNumberToObject(trip, "capacity_percent", (t->capacity_used / (float)FERRY_CAPACITY) * 100);
-        cJSON *vehicles_json = cJSON_CreateArray();
+        json_begin(&w, NULL, '{');
+        json_number(&w, "id", t->trip_id);
+        json_string(&w, "direction", t->direction == SIDE_X ? "X->Y" : "Y->X");
+        json_number(&w, "duration", t->duration);
+        json_number(&w, "capacity_used", t->capacity_used);
+        json_number(&w, "capacity_percent", (t->capacity_used / (float)FERRY_CAPACITY) * 100);
+        json_begin(&w, "vehicles", '[');
         for (int j = 0; j < t->vehicle_count; j++) {
-            for (int k = 0; k < TOTAL_VEHICLES; k++) {
-                if (vehicles[k].id == t->vehicle_ids[j]) {
-                    char buf[32];
-                    sprintf(buf, "%s%d", get_type_name(vehicles[k].type), t->vehicle_ids[j]);
-                    cJSON_AddItemToArray(vehicles_json, cJSON_CreateString(buf));
-                    break;
-                }
-            }
+            char buf[32];
+            sprintf(buf, "%s%d", get_type_name(vehicle_by_id(t->vehicle_ids[j])->type), t->vehicle_ids[j]);
+            json_string(&w, NULL, buf);
         }
-        cJSON_AddItemToObject(trip, "vehicles", vehicles_json);
-        cJSON_AddItemToArray(trips, trip);
+        json_end(&w, ']');
+        json_end(&w, '}');
     }
-    cJSON_AddItemToObject(root, "trips", trips);
+    json_end(&w, ']');
 
+    json_begin(&w, "vehicles", '[');
     for (int i = 0; i < TOTAL_VEHICLES; i++) {
-        cJSON *veh = cJSON_CreateObject();
-        cJSON_AddNumberToObject(veh, "id", vehicles[i].id);
-        cJSON_AddStringToObject(veh, "type", get_type_name(vehicles[i].type));
-        cJSON_AddStringToObject(veh, "start", vehicles[i].start_port == SIDE_X ? "X" : "Y");
-        cJSON_AddNumberToObject(veh, "wait_x", wait_time_x[i]);
-        cJSON_AddNumberToObject(veh, "wait_y", wait_time_y[i]);
-        cJSON_AddNumberToObject(veh, "ferry_x", ferry_time_x[i]);
-        cJSON_AddNumberToObject(veh, "ferry_y", ferry_time_y[i]);
-        cJSON_AddNumberToObject(veh, "round_trip", round_trip_time[i]);
-        cJSON_AddItemToArray(vehicles_array, veh);
+        json_begin(&w, NULL, '{');
+        json_number(&w, "id", vehicles[i].id);
+        json_string(&w, "type", get_type_name(vehicles[i].type));
+        json_string(&w, "start", vehicles[i].start_port == SIDE_X ? "X" : "Y");
+        json_number(&w, "wait_x", wait_time_x[i]);
+        json_number(&w, "wait_y", wait_time_y[i]);
+        json_number(&w, "ferry_x", ferry_time_x[i]);
+        json_number(&w, "ferry_y", ferry_time_y[i]);
+        json_number(&w, "round_trip", round_trip_time[i]);
+        json_end(&w, '}');
     }
-    cJSON_AddItemToObject(root, "vehicles", vehicles_array);
-
-    char *json_str = cJSON_Print(root);
-    FILE *fp = fopen("ferry_log.json", "w");
-    if (!fp) {
-        fprintf(stderr, "Error: Could not open ferry_log.json for writing.\n");
-    } else {
-        fprintf(fp, "%s\n", json_str);
-        fclose(fp);
-    }
-    free(json_str);
-    cJSON_Delete(root);
+    json_end(&w, ']');
+    json_end(&w, '}');
+    json_close(&w);
 }
 
 void show_final_statistics() {
+#ifndef HEADLESS
     endwin();
+#endif
     double total_wait_x = 0, total_wait_y = 0, total_ferry_x = 0, total_ferry_y = 0;
     double car_wait = 0, minibus_wait = 0, truck_wait = 0;
     double start_x_wait = 0, start_y_wait = 0;
@@ -304,7 +386,7 @@ void show_final_statistics() {
 
     printf("\n┳━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━ Final Statistics ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━┳\n");
     printf("┃ Duration: %.1fs | Trips: %d | Vehicles: %d/%d                                 ┃\n",
-           difftime(time(NULL), sim_start_time), trip_count, total_returned, TOTAL_VEHICLES);
+           difftime(sim_now(), sim_start_time), trip_count, total_returned, TOTAL_VEHICLES);
     printf("┣━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━┫\n");
     printf("┃ ID | Type      | Start | Wait X | Wait Y | Ferry X | Ferry Y | Round Trip   ┃\n");
     printf("┣━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━┫\n");
@@ -366,7 +448,7 @@ void show_final_statistics() {
 
 void* vehicle_func(void* arg) {
     Vehicle *v = (Vehicle*)arg;
-    v->trip_start = time(NULL);
+    v->trip_start = sim_now();
 
     while (v->boarded < 2 && !final_trip_done) {
         sem_wait(&pause_sem);
@@ -375,23 +457,16 @@ void* vehicle_func(void* arg) {
         int toll_index = (v->port == SIDE_X) ? rand() % TOLL_PER_SIDE : TOLL_PER_SIDE + (rand() % TOLL_PER_SIDE);
         sem_wait(&toll_sem[toll_index]);
 
-        if (v->port == SIDE_X) v->wait_start_x = time(NULL);
-        else v->wait_start_y = time(NULL);
+        if (v->port == SIDE_X) v->wait_start_x = sim_now();
+        else v->wait_start_y = sim_now();
 
-        pthread_mutex_lock(&print_mutex);
-        time_t now = time(NULL);
-        char time_str[20];
-        strftime(time_str, sizeof(time_str), "%H:%M:%S", localtime(&now));
-        wattron(log_win, COLOR_PAIR(v->type + 1));
-        wprintw(log_win, "[%s] %s%d passed toll at Side-%c\n", time_str, get_type_name(v->type), v->id, v->port == SIDE_X ? 'X' : 'Y');
-        wattroff(log_win, COLOR_PAIR(v->type + 1));
-        wrefresh(log_win);
-        pthread_mutex_unlock(&print_mutex);
+        log_event(v->type + 1, "%s%d passed toll at Side-%c\n", get_type_name(v->type), v->id, v->port == SIDE_X ? 'X' : 'Y');
 
         usleep(100000 / sim_speed);
         sem_post(&toll_sem[toll_index]);
 
         int boarded = 0;
+        unsigned long my_epoch = 0;
         while (!boarded && !final_trip_done) {
             sem_wait(&pause_sem);
             sem_post(&pause_sem);
@@ -401,13 +476,13 @@ void* vehicle_func(void* arg) {
                 (!is_first_return || v->port == SIDE_X) &&
                 (v->port == SIDE_Y ? current_trip_id >= v->y_trip_no + 2 : 1)) {
                 if (v->port == SIDE_X) {
-                    v->wait_end_x = time(NULL);
+                    v->wait_end_x = sim_now();
                     wait_time_x[v->id - 1] = difftime(v->wait_end_x, v->wait_start_x);
-                    v->ferry_start_x = time(NULL);
+                    v->ferry_start_x = sim_now();
                 } else {
-                    v->wait_end_y = time(NULL);
+                    v->wait_end_y = sim_now();
                     wait_time_y[v->id - 1] = difftime(v->wait_end_y, v->wait_start_y);
-                    v->ferry_start_y = time(NULL);
+                    v->ferry_start_y = sim_now();
                 }
                 ferry_capacity += v->capacity;
                 v->boarded++;
@@ -415,30 +490,25 @@ void* vehicle_func(void* arg) {
                 if (v->port == SIDE_X) v->x_trip_no = current_trip_id;
                 else v->y_trip_no = current_trip_id;
                 boarded = 1;
-                pthread_mutex_lock(&print_mutex);
-                strftime(time_str, sizeof(time_str), "%H:%M:%S", localtime(&now));
-                wattron(log_win, COLOR_PAIR(v->type + 1));
-                wprintw(log_win, "[%s] %s%d boarded at Side-%c (Load: %d)\n",
-                        time_str, get_type_name(v->type), v->id, v->port == SIDE_X ? 'X' : 'Y', ferry_capacity);
-                wattroff(log_win, COLOR_PAIR(v->type + 1));
-                wrefresh(log_win);
-                pthread_mutex_unlock(&print_mutex);
+                my_epoch = arrival_epoch;
+                log_event(v->type + 1, "%s%d boarded at Side-%c (Load: %d)\n",
+                          get_type_name(v->type), v->id, v->port == SIDE_X ? 'X' : 'Y', ferry_capacity);
             }
             pthread_mutex_unlock(&boarding_mutex);
             if (!boarded) usleep(200000 / sim_speed);
         }
 
-        while (ferry_side == v->port && !final_trip_done) {
-            sem_wait(&pause_sem);
-            sem_post(&pause_sem);
-            usleep(100000 / sim_speed);
-        }
+        // Ride until ferry_func bumps the arrival epoch on the other side
+        pthread_mutex_lock(&boarding_mutex);
+        while (boarded && arrival_epoch == my_epoch && !final_trip_done)
+            pthread_cond_wait(&ferry_arrived, &boarding_mutex);
+        pthread_mutex_unlock(&boarding_mutex);
 
         if (v->port == SIDE_X) {
-            v->ferry_end_x = time(NULL);
+            v->ferry_end_x = sim_now();
             ferry_time_x[v->id - 1] = difftime(v->ferry_end_x, v->ferry_start_x);
         } else {
-            v->ferry_end_y = time(NULL);
+            v->ferry_end_y = sim_now();
             ferry_time_y[v->id - 1] = difftime(v->ferry_end_y, v->ferry_start_y);
         }
         v->port = 1 - v->port;
@@ -448,17 +518,11 @@ void* vehicle_func(void* arg) {
         if (v->boarded == 2) {
             pthread_mutex_lock(&return_mutex);
             v->returned = 1;
-            v->trip_end = time(NULL);
+            v->trip_end = sim_now();
             round_trip_time[v->id - 1] = difftime(v->trip_end, v->trip_start);
             total_returned++;
-            pthread_mutex_lock(&print_mutex);
-            strftime(time_str, sizeof(time_str), "%H:%M:%S", localtime(&now));
-            wattron(log_win, COLOR_PAIR(v->type + 1));
-            wprintw(log_win, "[%s] %s%d completed round-trip in %.1fs\n",
-                    time_str, get_type_name(v->type), v->id, round_trip_time[v->id - 1]);
-            wattroff(log_win, COLOR_PAIR(v->type + 1));
-            wrefresh(log_win);
-            pthread_mutex_unlock(&print_mutex);
+            log_event(v->type + 1, "%s%d completed round-trip in %.1fs\n",
+                      get_type_name(v->type), v->id, round_trip_time[v->id - 1]);
             pthread_mutex_unlock(&return_mutex);
         }
     }
@@ -490,15 +554,8 @@ void* ferry_func(void* arg) {
             if (ferry_capacity >= FERRY_CAPACITY || !vehicles_waiting || wait_counter >= 10 ||
                 (is_first_return && ferry_side == SIDE_Y)) {
                 should_depart = 1;
-                if (!vehicles_waiting && ferry_capacity == 0 && !(is_first_return && ferry_side == SIDE_Y)) {
-                    pthread_mutex_lock(&print_mutex);
-                    time_t now = time(NULL);
-                    char time_str[20];
-                    strftime(time_str, sizeof(time_str), "%H:%M:%S", localtime(&now));
-                    wprintw(log_win, "[%s] No vehicles waiting at Side-%c\n", time_str, ferry_side == SIDE_X ? 'X' : 'Y');
-                    wrefresh(log_win);
-                    pthread_mutex_unlock(&print_mutex);
-                }
+                if (!vehicles_waiting && ferry_capacity == 0 && !(is_first_return && ferry_side == SIDE_Y))
+                    log_event(0, "No vehicles waiting at Side-%c\n", ferry_side == SIDE_X ? 'X' : 'Y');
             }
             wait_counter++;
             pthread_mutex_unlock(&boarding_mutex);
@@ -506,23 +563,18 @@ void* ferry_func(void* arg) {
         }
 
         pthread_mutex_lock(&boarding_mutex);
-        if (ferry_capacity > 0 || (is_first_return && ferry_side == SIDE_Y)) {
-            pthread_mutex_lock(&print_mutex);
-            time_t now = time(NULL);
-            char time_str[20];
-            strftime(time_str, sizeof(time_str), "%H:%M:%S", localtime(&now));
-            wattron(log_win, COLOR_PAIR(4));
-            wprintw(log_win, "[%s] Ferry departing from Side-%c to Side-%c with %d units\n",
-                    time_str, ferry_side == SIDE_X ? 'X' : 'Y', ferry_side == SIDE_X ? 'Y' : 'X', ferry_capacity);
-            wattroff(log_win, COLOR_PAIR(4));
-            wrefresh(log_win);
-            pthread_mutex_unlock(&print_mutex);
-        }
+        if (ferry_capacity > 0 || (is_first_return && ferry_side == SIDE_Y))
+            log_event(4, "Ferry departing from Side-%c to Side-%c with %d units\n",
+                      ferry_side == SIDE_X ? 'X' : 'Y', ferry_side == SIDE_X ? 'Y' : 'X', ferry_capacity);
 
-        double duration = (2 + (rand() % 8)) / sim_speed;
-        log_trip(ferry_side, duration, boarded_ids, boarded_count, ferry_capacity);
+        double crossing = 2 + (rand() % 8); // Simulated seconds
+        double duration = crossing / sim_speed;
+        log_trip(ferry_side, crossing, boarded_ids, boarded_count, ferry_capacity);
         current_trip_id++;
 
+#ifdef HEADLESS
+        usleep(duration * 1000000);
+#else
         int steps = 1000;
         for (int i = 0; i <= steps; i++) {
             sem_wait(&pause_sem);
@@ -530,8 +582,11 @@ void* ferry_func(void* arg) {
             draw_ferry_animation(i * 1000 / steps);
             usleep((float)(duration * 1000000 / steps) / sim_speed);
         }
+#endif
 
         ferry_side = 1 - ferry_side;
+        arrival_epoch++;
+        pthread_cond_broadcast(&ferry_arrived);
         ferry_capacity = 0;
         wait_counter = 0;
         boarded_count = 0;
@@ -547,6 +602,12 @@ void* ferry_func(void* arg) {
         pthread_mutex_unlock(&boarding_mutex);
     }
 
+    // Release any passenger still waiting after a quit
+    pthread_mutex_lock(&boarding_mutex);
+    pthread_cond_broadcast(&ferry_arrived);
+    pthread_mutex_unlock(&boarding_mutex);
+
+#ifndef HEADLESS
     pthread_mutex_lock(&print_mutex);
     wprintw(log_win, "\n=== Trip Summary ===\n");
     for (int i = 0; i < trip_count; i++) {
@@ -554,22 +615,18 @@ void* ferry_func(void* arg) {
         wprintw(log_win, "Trip %d:%s]: %.2fs | Capacity: %d/%d (%.1f%%) | Vehicles: ",
                 t->trip_id, t->direction == SIDE_X ? "X->Y" : "Y->X", t->duration,
                 t->capacity_used, FERRY_CAPACITY, (t->capacity_used / (float)FERRY_CAPACITY) * 100);
-        for (int j = 0; j < t->vehicle_count; j++) {
-            for (int k = 0; k < TOTAL_VEHICLES; k++) {
-                if (vehicles[k].id == t->vehicle_ids[j]) {
-                    wprintw(log_win, "%s%d ", get_type_name(vehicles[k].type), t->vehicle_ids[j]);
-                    break;
-                }
-            }
-        }
+        for (int j = 0; j < t->vehicle_count; j++)
+            wprintw(log_win, "%s%d ", get_type_name(vehicle_by_id(t->vehicle_ids[j])->type), t->vehicle_ids[j]);
         wprintw(log_win, "\n");
     }
     wrefresh(log_win);
     pthread_mutex_unlock(&print_mutex);
+#endif
 
     return NULL;
 }
 
+#ifndef HEADLESS
 void* print_state(void* arg) {
     int wait_counter = 0;
     while (!final_trip_done) {
@@ -770,42 +827,24 @@ void* print_state(void* arg) {
 void* input_func(void* arg) {
     while (!final_trip_done) {
         int ch = getch();
-        time_t now = time(NULL);
-        char time_str[20];
-        strftime(time_str, sizeof(time_str), "%H:%M:%S", localtime(&now));
         switch (ch) {
             case 'p':
             case 'P':
                 sem_wait(&pause_sem);
                 paused = !paused;
-                pthread_mutex_lock(&print_mutex);
-                wattron(log_win, COLOR_PAIR(3));
-                wprintw(log_win, "[%s] Simulation %s\n", time_str, paused ? "paused" : "resumed");
-                wattroff(log_win, COLOR_PAIR(3));
-                wrefresh(log_win);
-                pthread_mutex_unlock(&print_mutex);
+                log_event(3, "Simulation %s\n", paused ? "paused" : "resumed");
                 if (!paused) sem_post(&pause_sem);
                 break;
             case '+':
                 if (sim_speed < 5.0) {
                     sim_speed += 0.5;
-                    pthread_mutex_lock(&print_mutex);
-                    wattron(log_win, COLOR_PAIR(2));
-                    wprintw(log_win, "[%s] Speed increased to %.1fx\n", time_str, sim_speed);
-                    wattroff(log_win, COLOR_PAIR(2));
-                    wrefresh(log_win);
-                    pthread_mutex_unlock(&print_mutex);
+                    log_event(2, "Speed increased to %.1fx\n", sim_speed);
                 }
                 break;
             case '-':
                 if (sim_speed > 0.5) {
                     sim_speed -= 0.5;
-                    pthread_mutex_lock(&print_mutex);
-                    wattron(log_win, COLOR_PAIR(2));
-                    wprintw(log_win, "[%s] Speed decreased to %.1fx\n", time_str, sim_speed);
-                    wattroff(log_win, COLOR_PAIR(2));
-                    wrefresh(log_win);
-                    pthread_mutex_unlock(&print_mutex);
+                    log_event(2, "Speed decreased to %.1fx\n", sim_speed);
                 }
                 break;
             case 'q':
@@ -820,11 +859,16 @@ void* input_func(void* arg) {
     }
     return NULL;
 }
+#endif
 
 int main() {
     srand(time(NULL));
     sim_start_time = time(NULL);
+    clock_gettime(CLOCK_MONOTONIC, &wall_start);
 
+#ifdef HEADLESS
+    sim_speed = HEADLESS_SPEED;
+#else
     // Initialize ncurses
     if (!initscr()) {
         fprintf(stderr, "Error: Failed to initialize ncurses.\n");
@@ -868,6 +912,7 @@ int main() {
         return 1;
     }
     scrollok(log_win, TRUE);
+#endif
 
     // Initialize semaphores
     sem_init(&pause_sem, 0, 1);
@@ -897,10 +942,13 @@ int main() {
 
     // Create threads
     pthread_t vehicle_threads[TOTAL_VEHICLES];
-    pthread_t ferry_thread, printer_thread, input_thread;
+    pthread_t ferry_thread;
     pthread_create(&ferry_thread, NULL, ferry_func, NULL);
+#ifndef HEADLESS
+    pthread_t printer_thread, input_thread;
     pthread_create(&printer_thread, NULL, print_state, NULL);
     pthread_create(&input_thread, NULL, input_func, NULL);
+#endif
     for (int i = 0; i < TOTAL_VEHICLES; i++)
         pthread_create(&vehicle_threads[i], NULL, vehicle_func, &vehicles[i]);
 
@@ -908,19 +956,23 @@ int main() {
     for (int i = 0; i < TOTAL_VEHICLES; i++)
         pthread_join(vehicle_threads[i], NULL);
     pthread_join(ferry_thread, NULL);
+#ifndef HEADLESS
     pthread_join(printer_thread, NULL);
     pthread_join(input_thread, NULL);
+#endif
 
     // Show final statistics
     show_final_statistics();
 
     // Cleanup
+#ifndef HEADLESS
     delwin(main_win);
     delwin(ferry_win);
     delwin(stats_win);
     delwin(log_win);
     delwin(status_win);
     endwin();
+#endif
 
     for (int i = 0; i < 4; i++) sem_destroy(&toll_sem[i]);
     sem_destroy(&pause_sem);
@@ -928,6 +980,7 @@ int main() {
     pthread_mutex_destroy(&return_mutex);
     pthread_mutex_destroy(&log_mutex);
     pthread_mutex_destroy(&print_mutex);
+    pthread_cond_destroy(&ferry_arrived);
 
     printf("\nSimulation completed. Log saved to ferry_log.json!\n");
     return 0;
@@ -0,0 +1,254 @@
+// Benchmarks for Ferry-Tour-Simulation.c: microbenchmarks of the hot primitives
+// and scaling runs of the event engine over fleet size, cores and ferry
+// capacity. Every result is one JSON object per line on stdout, so runs can be
+// stored and compared to catch regressions.
+//
+// ferry_bench [--quick] [--filter TEXT] [--budget SECONDS] [--max-vehicles N] [--threads N]
+#define FERRY_NO_MAIN
+#include "Ferry-Tour-Simulation.c"
+
+double bench_min_time = 0.2; // Seconds each microbenchmark runs for at least
+double bench_budget = 30; // A scaling series stops after a run longer than this
+const char *bench_filter = NULL; // Only benchmarks whose name contains this
+volatile long bench_sink; // Results go here so the compiler can't drop the work
+
+double bench_seconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+int bench_selected(const char *name) {
+    return !bench_filter || strstr(name, bench_filter);
+}
+
+// A simulation of the default class mix, resized; nothing runs yet
+Simulation *bench_simulation(int vehicles, int capacity, int event_mode) {
+    SimConfig config = default_config;
+    config_scale_vehicles(&config, vehicles);
+    config.ferry_capacity = capacity;
+    config.event_mode = event_mode;
+    config.seed = 1;
+    return simulation_create(&config);
+}
+
+// Runs op in doubling batches until one takes bench_min_time, then reports the cost per call
+void run_micro(const char *name, Simulation *sim, void (*op)(Simulation *, long)) {
+    if (!bench_selected(name)) return;
+    long n = 1;
+    double elapsed;
+    while (1) {
+        double start = bench_seconds();
+        for (long i = 0; i < n; i++) op(sim, i);
+        elapsed = bench_seconds() - start;
+        if (elapsed >= bench_min_time) break;
+        n *= 2;
+    }
+    printf("{\"bench\":\"%s\",\"kind\":\"micro\",\"vehicles\":%d,\"capacity\":%d,\"iterations\":%ld,\"ns_per_op\":%.2f}\n",
+           name, sim->total_vehicles, sim->config.ferry_capacity, n, elapsed * 1e9 / n);
+    fflush(stdout);
+}
+
+// Departure decision with every vehicle in Side-A's square
+void op_should_depart(Simulation *sim, long i) {
+    bench_sink += ferry_should_depart(sim, &sim->ferries[0], i % sim->config.max_ferry_checks);
+}
+
+// The reachable-load query after a vehicle left, which forces a rebuild
+void op_best_fill_rebuild(Simulation *sim, long i) {
+    sim->gate_reach[SIDE_A].dirty = 1;
+    bench_sink += best_fill(&sim->gate_reach[SIDE_A], sim->config.ferry_capacity - (int)(i % 7));
+}
+
+// The same query while the bitset is current
+void op_best_fill(Simulation *sim, long i) {
+    bench_sink += best_fill(&sim->gate_reach[SIDE_A], sim->config.ferry_capacity - (int)(i % 7));
+}
+
+// Recording a full trip; the log is emptied now and then so it stays in cache like a real run's tail
+void op_log_trip(Simulation *sim, long i) {
+    if (sim->trip_count == 4096) sim->trip_count = sim->manifest_count = 0;
+    Ferry *f = &sim->ferries[0];
+    int count = sim->config.ferry_capacity < sim->total_vehicles ? sim->config.ferry_capacity : sim->total_vehicles;
+    f->side = i & 1;
+    f->boarded_count = f->load = count;
+    log_trip(sim, f, 5.0, count);
+}
+
+// Choosing a booth, claiming it and handing it back, as a vehicle does
+void op_toll(Simulation *sim, long i) {
+    int booth = toll_choose(sim, (int)(i & 1), &sim->ferries[0].rng);
+    if (booth_arrive(sim, booth, 0)) booth_leave(sim, booth);
+}
+
+// An uncontended boarding_mutex round trip, through the profiler when it is built in
+void op_lock(Simulation *sim, long i) {
+    (void)i;
+    LOCK_MUTEX(sim, LK_BOARDING, &sim->boarding_mutex);
+    UNLOCK_MUTEX(sim, LK_BOARDING, &sim->boarding_mutex);
+}
+
+void op_publish_snapshot(Simulation *sim, long i) {
+    (void)i;
+    publish_snapshot(sim, 1);
+}
+
+void op_read_snapshot(Simulation *sim, long i) {
+    (void)i;
+    StateSnapshot snap;
+    read_snapshot(sim, &snap);
+    bench_sink += snap.load;
+}
+
+FILE *bench_devnull;
+
+void op_render(Simulation *sim, long i) {
+    StateSnapshot snap;
+    read_snapshot(sim, &snap);
+    render_state(sim, &snap, (int)i, bench_devnull);
+}
+
+void op_write_text_log(Simulation *sim, long i) {
+    (void)i;
+    write_log_file(sim);
+}
+
+void op_write_json_log(Simulation *sim, long i) {
+    (void)i;
+    write_json_log(sim);
+}
+
+void run_micro_benchmarks() {
+    int sizes[] = {50, 1000, 100000};
+    for (int k = 0; k < 3; k++) {
+        Simulation *sim = bench_simulation(sizes[k], 50, 1);
+        for (int i = 0; i < sim->total_vehicles; i++) join_square(sim, i);
+        for (int i = 0; i < sim->config.ferry_capacity; i++) sim->ferries[0].boarded_ids[i] = i % sim->total_vehicles + 1;
+        run_micro("decision/ferry_should_depart", sim, op_should_depart);
+        run_micro("decision/best_fill_rebuild", sim, op_best_fill_rebuild);
+        run_micro("decision/best_fill", sim, op_best_fill);
+        if (k == 0) {
+            run_micro("log/log_trip", sim, op_log_trip);
+            run_micro("lock/boarding", sim, op_lock);
+        }
+        simulation_destroy(sim);
+    }
+
+    // Snapshots are only published by real-time simulations, and only they lock booths
+    Simulation *sim = bench_simulation(1000, 50, 0);
+    run_micro("toll/acquire_release", sim, op_toll);
+    for (int i = 0; i < sim->total_vehicles; i++) join_square(sim, i);
+    run_micro("render/publish_snapshot", sim, op_publish_snapshot);
+    run_micro("render/read_snapshot", sim, op_read_snapshot);
+    run_micro("render/frame", sim, op_render);
+    simulation_destroy(sim);
+
+    // Log writers over a finished run
+    sim = bench_simulation(1000, 50, 1);
+    simulation_run(sim);
+    run_micro("log/write_text", sim, op_write_text_log);
+    run_micro("log/write_json", sim, op_write_json_log);
+    simulation_destroy(sim);
+}
+
+typedef struct {
+    int vehicles, capacity;
+    unsigned long events;
+    double sim_seconds;
+} ScaleRun;
+
+void* scale_worker(void* arg) {
+    ScaleRun *run = arg;
+    Simulation *sim = bench_simulation(run->vehicles, run->capacity, 1);
+    run->events = simulation_run(sim);
+    run->sim_seconds = sim->sim_clock;
+    simulation_destroy(sim);
+    return NULL;
+}
+
+// threads independent event-mode runs side by side. Returns the wall time, or
+// -1 if the series was already over budget and the run was skipped.
+double run_scale(const char *name, int vehicles, int capacity, int threads, int *over_budget) {
+    if (!bench_selected(name)) return 0;
+    if (*over_budget) {
+        printf("{\"bench\":\"%s\",\"kind\":\"scale\",\"vehicles\":%d,\"capacity\":%d,\"threads\":%d,\"skipped\":\"budget\"}\n",
+               name, vehicles, capacity, threads);
+        return -1;
+    }
+    ScaleRun *runs = calloc(threads, sizeof(ScaleRun));
+    pthread_t *tids = malloc(sizeof(pthread_t) * threads);
+    double start = bench_seconds();
+    for (int t = 0; t < threads; t++) {
+        runs[t] = (ScaleRun){vehicles, capacity, 0, 0};
+        pthread_create(&tids[t], NULL, scale_worker, &runs[t]);
+    }
+    for (int t = 0; t < threads; t++) pthread_join(tids[t], NULL);
+    double wall = bench_seconds() - start;
+
+    unsigned long events = 0;
+    double sim_seconds = 0;
+    for (int t = 0; t < threads; t++) {
+        events += runs[t].events;
+        sim_seconds += runs[t].sim_seconds;
+    }
+    printf("{\"bench\":\"%s\",\"kind\":\"scale\",\"vehicles\":%d,\"capacity\":%d,\"threads\":%d,"
+           "\"events\":%lu,\"wall_s\":%.6f,\"sim_s\":%.2f,\"events_per_s\":%.0f,\"sim_s_per_wall_s\":%.1f}\n",
+           name, vehicles, capacity, threads, events, wall, sim_seconds, events / wall, sim_seconds / wall);
+    fflush(stdout);
+    if (wall > bench_budget) *over_budget = 1;
+    free(runs);
+    free(tids);
+    return wall;
+}
+
+void run_scale_benchmarks(int max_vehicles, int max_threads, int max_capacity) {
+    int over_budget = 0;
+    for (int n = 1; n <= max_vehicles; n *= 10) run_scale("scale/vehicles", n, 50, 1, &over_budget);
+
+    // Same-sized runs on more threads: flat wall time means linear scaling
+    over_budget = 0;
+    for (int t = 1; t <= max_threads; t *= 2) run_scale("scale/threads", 1000, 50, t, &over_budget);
+
+    over_budget = 0;
+    int capacities[] = {20, 100, 1000, 10000};
+    for (int k = 0; k < 4 && capacities[k] <= max_capacity; k++)
+        run_scale("scale/capacity", 10000, capacities[k], 1, &over_budget);
+}
+
+int main(int argc, char *argv[]) {
+    int max_vehicles = 1000000, max_capacity = 10000;
+    int max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--quick") == 0) {
+            bench_min_time = 0.05;
+            max_vehicles = 10000;
+            max_capacity = 1000;
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) bench_filter = argv[++i];
+        else if (strcmp(argv[i], "--budget") == 0 && i + 1 < argc) bench_budget = atof(argv[++i]);
+        else if (strcmp(argv[i], "--max-vehicles") == 0 && i + 1 < argc) max_vehicles = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) max_threads = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "Usage: %s [--quick] [--filter TEXT] [--budget SECONDS] [--max-vehicles N] [--threads N]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+    if (max_threads < 1) max_threads = 1;
+
+    // The log writers write into the working directory; keep them out of the caller's
+    char dir[] = "/tmp/ferry_bench.XXXXXX";
+    if (!mkdtemp(dir) || chdir(dir) < 0) {
+        fprintf(stderr, "Error: Could not create a scratch directory.\n");
+        return 1;
+    }
+    bench_devnull = fopen("/dev/null", "w");
+
+    run_micro_benchmarks();
+    run_scale_benchmarks(max_vehicles, max_threads, max_capacity);
+
+    fclose(bench_devnull);
+    unlink("ferry_log.txt");
+    unlink("ferry_log.json");
+    rmdir(dir);
+    return 0;
+}
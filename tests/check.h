@@ -0,0 +1,22 @@
+// Minimal checks for the unit tests in this directory. Each test includes the
+// simulator with FERRY_NO_MAIN, as ferry_bench does, so it can reach any
+// function; a failed CHECK is reported and the test exits non-zero at the end.
+#define FERRY_NO_MAIN
+#include "../Ferry-Tour-Simulation.c"
+
+int check_failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s: ", __FILE__, __LINE__, #cond); \
+        fprintf(stderr, __VA_ARGS__); \
+        fprintf(stderr, "\n"); \
+        check_failures++; \
+    } \
+} while (0)
+
+// Exit status for main
+int check_result(const char *name) {
+    if (check_failures) fprintf(stderr, "%s: %d checks failed\n", name, check_failures);
+    return check_failures ? 1 : 0;
+}
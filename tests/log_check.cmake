@@ -0,0 +1,42 @@
+# Run the simulator in a scratch directory and check the logs it leaves behind.
+#   FERRY        path to the simulator
+#   WORK_DIR     scratch directory, recreated on every run
+#   RUN_ARGS     ;-separated command line
+#   JSON_KEYS    keys that must appear in ferry_log.json
+#   REPEAT       when set, run twice and require byte-identical logs
+file(REMOVE_RECURSE "${WORK_DIR}")
+file(MAKE_DIRECTORY "${WORK_DIR}")
+
+function(run_ferry suffix)
+    execute_process(COMMAND "${FERRY}" ${RUN_ARGS} WORKING_DIRECTORY "${WORK_DIR}"
+                    RESULT_VARIABLE status OUTPUT_QUIET ERROR_VARIABLE errors)
+    if(NOT status EQUAL 0)
+        message(FATAL_ERROR "ferry ${RUN_ARGS} exited with ${status}\n${errors}")
+    endif()
+    foreach(log ferry_log.txt ferry_log.json)
+        if(NOT EXISTS "${WORK_DIR}/${log}")
+            message(FATAL_ERROR "${log} was not written")
+        endif()
+        file(RENAME "${WORK_DIR}/${log}" "${WORK_DIR}/${log}${suffix}")
+    endforeach()
+endfunction()
+
+run_ferry(.1)
+file(READ "${WORK_DIR}/ferry_log.json.1" json)
+foreach(key ${JSON_KEYS})
+    string(FIND "${json}" "\"${key}\":" at)
+    if(at EQUAL -1)
+        message(FATAL_ERROR "ferry_log.json has no \"${key}\" field")
+    endif()
+endforeach()
+
+if(REPEAT)
+    run_ferry(.2)
+    foreach(log ferry_log.txt ferry_log.json)
+        execute_process(COMMAND "${CMAKE_COMMAND}" -E compare_files "${WORK_DIR}/${log}.1" "${WORK_DIR}/${log}.2"
+                        RESULT_VARIABLE differ)
+        if(differ)
+            message(FATAL_ERROR "${log} differs between two runs of ${RUN_ARGS}")
+        endif()
+    endforeach()
+endif()
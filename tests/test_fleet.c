@@ -0,0 +1,139 @@
+// Fleets: several vessels sharing the squares and berths, in event mode and in
+// real time. No vehicle rides a leg twice, no side ever has more vessels docked
+// than it has berths, and every vehicle comes back exactly once.
+#include "check.h"
+
+typedef struct {
+    const char *label;
+    int berths;
+    int vessels;
+    VesselSpec specs[3];
+    int autoscale;
+} FleetCase;
+
+const FleetCase cases[] = {
+    {"two vessels, one berth", 1, 2, {{"F1", 30, 1}, {"F2", 20, 1.5}}, 0},
+    {"three vessels, two berths", 2, 3, {{"F1", 30, 1}, {"F2", 20, 1.5}, {"F3", 12, 3}}, 0},
+    {"three vessels, one berth, autoscaled tolls", 1, 3, {{"F1", 30, 1}, {"F2", 20, 1.5}, {"F3", 12, 3}}, 1},
+};
+
+SimConfig fleet_config(const FleetCase *c, uint64_t seed, int vehicles) {
+    SimConfig config = default_config;
+    config_scale_vehicles(&config, vehicles);
+    config.vessel_count = c->vessels;
+    memcpy(config.vessels, c->specs, sizeof(c->specs));
+    config.ferry_capacity = config_largest_vessel(&config);
+    config.berths = c->berths;
+    config.toll_autoscale = c->autoscale;
+    config.seed = seed;
+    return config;
+}
+
+// Vessels holding a berth at side never outnumber the berths, and every berth is either held or free.
+// Caller holds boarding_mutex in real-time mode.
+void check_berths(Simulation *sim, const char *label) {
+    for (int side = 0; side < 2; side++) {
+        int docked = 0, waiting = 0;
+        for (int k = 0; k < sim->ferry_count; k++) {
+            docked += sim->ferries[k].side == side && sim->ferries[k].state == FERRY_DOCKED;
+            waiting += sim->ferries[k].side == side && sim->ferries[k].state == FERRY_WAITING;
+        }
+        CHECK(docked <= sim->config.berths, "%s: %d vessels docked at side %d with %d berths", label, docked, side,
+              sim->config.berths);
+        CHECK(docked + sim->berths_free[side] == sim->config.berths, "%s: side %d has %d docked and %d berths free",
+              label, side, docked, sim->berths_free[side]);
+        CHECK(!waiting || !sim->berths_free[side], "%s: %d vessels wait at side %d beside a free berth", label, waiting,
+              side);
+    }
+}
+
+// Once the run is over: each vehicle crossed each way exactly once, on a trip
+// whose load adds up and fits its vessel, and came back exactly once
+void check_manifests(Simulation *sim, const char *label) {
+    int *legs = calloc(2 * sim->total_vehicles, sizeof(int)); // Crossings per vehicle and direction
+    for (int t = 0; t < sim->trip_count; t++) {
+        Trip *trip = &sim->trip_log[t];
+        int *ids = trip_vehicle_ids(sim, trip), units = 0;
+        for (int j = 0; j < trip->vehicle_count; j++) {
+            int *crossed = &legs[2 * (ids[j] - 1) + trip->direction];
+            CHECK(*crossed == 0, "%s: vehicle %d on a second %s manifest, trip %d", label, ids[j],
+                  trip->direction == SIDE_A ? "A->B" : "B->A", trip->trip_id);
+            (*crossed)++;
+            units += vehicle_by_id(sim, ids[j])->capacity;
+        }
+        CHECK(units == trip->capacity_used && units <= trip_capacity(sim, trip),
+              "%s: trip %d carries %d units, logged %d, vessel holds %d", label, trip->trip_id, units,
+              trip->capacity_used, trip_capacity(sim, trip));
+    }
+    int returned = 0;
+    for (int i = 0; i < sim->total_vehicles; i++) {
+        CHECK(legs[2 * i] == 1 && legs[2 * i + 1] == 1, "%s: vehicle %d crossed A->B %d times and B->A %d times", label,
+              i + 1, legs[2 * i], legs[2 * i + 1]);
+        CHECK(sim->records[i].returned == 1 && sim->vehicles[i].state == V_DONE,
+              "%s: vehicle %d never came back", label, i + 1);
+        returned += sim->records[i].returned;
+    }
+    CHECK(returned == sim->total_vehicles && sim->total_returned == sim->total_vehicles,
+          "%s: %d vehicles marked returned, %d counted, of %d", label, returned, sim->total_returned, sim->total_vehicles);
+    free(legs);
+}
+
+// Event mode, stepped like run_event_simulation with the berths checked after every event
+void check_event_run(const FleetCase *c, uint64_t seed) {
+    SimConfig config = fleet_config(c, seed, 300);
+    config.event_mode = 1;
+    Simulation *sim = simulation_create(&config);
+    schedule_start(sim);
+    check_berths(sim, c->label);
+    Event e;
+    while (!sim->final_trip_done && pop_event(sim, &e)) {
+        sim->sim_clock = e.time;
+        handle_event(sim, &e);
+        check_berths(sim, c->label);
+    }
+    latency_thread_exit(sim);
+    free(sim->event_queue);
+    check_manifests(sim, c->label);
+    simulation_destroy(sim);
+}
+
+// Real time: a watcher samples the berths under boarding_mutex while the vessel
+// threads run. simulation_run queues the fleet before any thread that locks, then
+// publishes the first snapshot; its sequence number says the berths are set up.
+void *berth_watcher(void *arg) {
+    Simulation *sim = arg;
+    while (__atomic_load_n(&sim->snapshot_seq, __ATOMIC_ACQUIRE) < 2) usleep(100);
+    while (!__atomic_load_n(&sim->final_trip_done, __ATOMIC_ACQUIRE)) {
+        LOCK_MUTEX(sim, LK_BOARDING, &sim->boarding_mutex);
+        check_berths(sim, "real time");
+        UNLOCK_MUTEX(sim, LK_BOARDING, &sim->boarding_mutex);
+        usleep(200);
+    }
+    return NULL;
+}
+
+void check_real_time_run(const FleetCase *c, uint64_t seed) {
+    SimConfig config = fleet_config(c, seed, 60);
+    // Short enough that the run takes about a second
+    config.crossing_time = (Distribution){DIST_FIXED, 0.02, 0};
+    config.dwell_time = (Distribution){DIST_FIXED, 0.01, 0};
+    config.toll_service = (Distribution){DIST_FIXED, 0.001, 0};
+    config.poll_interval = 0.005;
+    config.toll_scale_interval = 0.01;
+    Simulation *sim = simulation_create(&config);
+    pthread_t watcher;
+    pthread_create(&watcher, NULL, berth_watcher, sim);
+    simulation_run(sim);
+    pthread_join(watcher, NULL);
+    check_manifests(sim, c->label);
+    simulation_destroy(sim);
+}
+
+int main() {
+    if (!freopen("/dev/null", "w", stdout)) return 1; // The real-time runs narrate every vehicle
+    for (size_t k = 0; k < sizeof(cases) / sizeof(cases[0]); k++) {
+        for (uint64_t seed = 1; seed <= 20; seed++) check_event_run(&cases[k], seed);
+        check_real_time_run(&cases[k], 1);
+    }
+    return check_result("test_fleet");
+}
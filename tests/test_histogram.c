@@ -0,0 +1,144 @@
+// LatencyHistogram: percentiles against the exact order statistics, and the
+// per-thread histograms that record_latency fills merged without losing a count
+#include "check.h"
+
+#define SAMPLES 20000
+#define THREADS 8
+
+int64_t sorted[SAMPLES];
+
+int ns_order(const void *a, const void *b) {
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// The q quantile as hist_percentile defines it: the ceil(q * n)-th smallest value
+int64_t exact_percentile(int64_t *values, int n, double q) {
+    long rank = (long)ceil(q * n);
+    if (rank < 1) rank = 1;
+    return values[rank - 1];
+}
+
+// Every documented percentile of values is within one sub-bucket (1/32) of the exact one
+void check_percentiles(const char *label, int64_t *values, int n) {
+    static const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+    LatencyHistogram *h = calloc(1, sizeof(LatencyHistogram));
+    for (int k = 0; k < n; k++) hist_record(h, values[k]);
+    memcpy(sorted, values, sizeof(int64_t) * n);
+    qsort(sorted, n, sizeof(int64_t), ns_order);
+    CHECK(h->count == n, "%s: count %ld, recorded %d", label, h->count, n);
+    CHECK(h->min == sorted[0] && h->max == sorted[n - 1], "%s: min/max %lld/%lld, want %lld/%lld", label,
+          (long long)h->min, (long long)h->max, (long long)sorted[0], (long long)sorted[n - 1]);
+    for (int k = 0; k < 4; k++) {
+        int64_t want = exact_percentile(sorted, n, quantiles[k]);
+        double got = hist_percentile(h, quantiles[k]) * 1e9;
+        // Values below 64 ns have a bucket each; above, the bucket midpoint is within 1/64 of any
+        // value in it, and the documented bound is one sub-bucket, 1/32
+        double bound = want < (2 << HIST_SUB_BITS) ? 0.5 : want / (double)(1 << HIST_SUB_BITS);
+        CHECK(fabs(got - want) <= bound, "%s: p%g is %.0f ns, exact %lld ns", label, quantiles[k] * 100, got,
+              (long long)want);
+    }
+    free(h);
+}
+
+// Log-uniform values from 1 ns to about 17 minutes
+int64_t sample_ns(RngStream *r) {
+    return (int64_t)exp(rng_double(r) * log(1e12));
+}
+
+typedef struct {
+    Simulation *sim;
+    int thread;
+} Recorder;
+
+// The values a recorder thread records, regenerated the same way for the reference histograms
+void recorder_values(int thread, int64_t *values) {
+    RngStream r;
+    rng_seed(&r, 42, thread);
+    for (int k = 0; k < SAMPLES; k++) values[k] = sample_ns(&r);
+}
+
+void *recorder_func(void *arg) {
+    Recorder *rec = arg;
+    int64_t *values = malloc(sizeof(int64_t) * SAMPLES);
+    recorder_values(rec->thread, values);
+    for (int k = 0; k < SAMPLES; k++)
+        record_latency(rec->sim, LAT_WAIT, rec->thread % rec->sim->config.class_count, k & 1, values[k]);
+    free(values);
+    latency_thread_exit(rec->sim);
+    return NULL;
+}
+
+// Threads record into their own histograms and merge them on exit; the merged
+// set must match recording every value into one histogram, bucket for bucket
+void check_thread_merge() {
+    SimConfig config = default_config;
+    config.event_mode = 1;
+    Simulation *sim = simulation_create(&config);
+    pthread_t threads[THREADS];
+    Recorder recorders[THREADS];
+    for (int t = 0; t < THREADS; t++) {
+        recorders[t] = (Recorder){sim, t};
+        pthread_create(&threads[t], NULL, recorder_func, &recorders[t]);
+    }
+    for (int t = 0; t < THREADS; t++) pthread_join(threads[t], NULL);
+
+    int cells = config.class_count * 2;
+    LatencyHistogram *want = calloc(cells, sizeof(LatencyHistogram));
+    int64_t *values = malloc(sizeof(int64_t) * SAMPLES);
+    for (int t = 0; t < THREADS; t++) {
+        recorder_values(t, values);
+        for (int k = 0; k < SAMPLES; k++) hist_record(&want[(t % config.class_count) * 2 + (k & 1)], values[k]);
+    }
+    long total = 0;
+    for (int c = 0; c < config.class_count; c++)
+        for (int side = 0; side < 2; side++) {
+            LatencyHistogram *got = latency_hist(sim, sim->latency, LAT_WAIT, c, side), *w = &want[c * 2 + side];
+            CHECK(got->count == w->count && got->sum == w->sum && got->min == w->min && got->max == w->max,
+                  "class %d side %d: count %ld sum %lld, want %ld %lld", c, side, got->count, (long long)got->sum,
+                  w->count, (long long)w->sum);
+            CHECK(memcmp(got->buckets, w->buckets, sizeof(got->buckets)) == 0, "class %d side %d: buckets differ", c, side);
+            total += got->count;
+        }
+    CHECK(total == (long)THREADS * SAMPLES, "merged %ld values, recorded %ld", total, (long)THREADS * SAMPLES);
+    LatencyHistogram all = latency_total(sim, LAT_WAIT);
+    CHECK(all.count == total, "latency_total counts %ld of %ld", all.count, total);
+    free(values);
+    free(want);
+    simulation_destroy(sim);
+}
+
+int main() {
+    static int64_t values[SAMPLES];
+    RngStream r;
+    rng_seed(&r, 7, 0);
+
+    for (int k = 0; k < SAMPLES; k++) values[k] = sample_ns(&r);
+    check_percentiles("log-uniform", values, SAMPLES);
+    for (int k = 0; k < SAMPLES; k++) values[k] = rng_below(&r, 64);
+    check_percentiles("below 64 ns", values, SAMPLES);
+    for (int k = 0; k < SAMPLES; k++) values[k] = 5000000 + rng_below(&r, 1000); // 5 ms, the range %.2f lost
+    check_percentiles("about 5 ms", values, SAMPLES);
+    for (int k = 0; k < SAMPLES; k++) values[k] = k % 100 == 0 ? 2000000000LL + k : 1000 + k % 7; // Rare 2 s stalls
+    check_percentiles("bimodal", values, SAMPLES);
+    for (int n = 1; n <= 3; n++) {
+        for (int k = 0; k < n; k++) values[k] = 1000 * (k + 1);
+        check_percentiles("tiny", values, n);
+    }
+
+    // Out of range values are clamped, not dropped
+    LatencyHistogram *h = calloc(1, sizeof(LatencyHistogram));
+    hist_record(h, -5);
+    hist_record(h, HIST_MAX_NS * 4);
+    CHECK(h->count == 2 && h->min == 0 && h->max == HIST_MAX_NS, "count %ld min %lld max %lld", h->count,
+          (long long)h->min, (long long)h->max);
+    CHECK(h->buckets[0] == 1 && h->buckets[hist_bucket(HIST_MAX_NS)] == 1, "clamped values not in the end buckets");
+    LatencyHistogram empty = {0};
+    hist_merge(h, &empty);
+    CHECK(h->count == 2 && h->min == 0, "merging an empty histogram changed count %ld min %lld", h->count,
+          (long long)h->min);
+    free(h);
+
+    check_thread_merge();
+    return check_result("test_histogram");
+}
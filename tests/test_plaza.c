@@ -0,0 +1,122 @@
+// plaza_control: a side's booths driven through a rush and a lull with real
+// arrivals and departures, checking every decision against the thresholds
+#include "check.h"
+
+#define PER_SIDE 4
+#define MIN_OPEN 2
+#define STEPS 4000
+
+int serving[2 * PER_SIDE]; // Vehicle at each booth's window, -1 if none
+
+// Seconds the side's backlog would take to clear with open booths, as plaza_control estimates it
+double drain_time(Simulation *sim, int side, int open) {
+    long load = 0, served = 0;
+    int64_t busy = 0;
+    for (int k = side * PER_SIDE; k < (side + 1) * PER_SIDE; k++) {
+        load += sim->booths[k].load;
+        served += sim->booths[k].served;
+        busy += sim->booths[k].busy_ns;
+    }
+    double mean = served && busy ? busy / 1e9 / served : dist_mean(&sim->config.toll_service);
+    return load * mean / open;
+}
+
+int main() {
+    SimConfig config = default_config;
+    config.classes[0].count = 4000; // Enough vehicles that every arrival is a fresh one
+    config.toll_per_side = PER_SIDE;
+    config.toll_autoscale = 1;
+    config.toll_min_open = MIN_OPEN;
+    config.toll_scale_up = 2;
+    config.toll_scale_down = 0.5;
+    config.event_mode = 1;
+    Simulation *sim = simulation_create(&config);
+    RngStream r;
+    rng_seed(&r, 3, 0);
+    for (int k = 0; k < 2 * PER_SIDE; k++) serving[k] = -1;
+
+    int next_vehicle = 0, opened = 0, closed = 0, held = 0, reached_max = 0;
+    for (int step = 0; step < STEPS && next_vehicle < sim->total_vehicles - 8; step++) {
+        sim->sim_clock += 0.05;
+        // Rushes and lulls: more arrivals than one booth can serve, then none
+        int rush = step / 500 % 2 == 0;
+        for (int side = 0; side < 2; side++) {
+            int arrivals = rush ? rng_below(&r, 3) : 0, departures = rng_below(&r, 3);
+            for (int a = 0; a < arrivals; a++) {
+                int i = next_vehicle++, booth = toll_choose(sim, side, &r);
+                CHECK(booth - side * PER_SIDE < sim->toll_open[side], "vehicle sent to closed booth %d", booth);
+                if (booth_arrive(sim, booth, i)) serving[booth] = i;
+            }
+            for (int d = 0; d < departures; d++) {
+                int booth = side * PER_SIDE + rng_below(&r, PER_SIDE);
+                if (serving[booth] >= 0) serving[booth] = booth_leave(sim, booth);
+            }
+        }
+
+        int before[2] = {sim->toll_open[SIDE_A], sim->toll_open[SIDE_B]}, started[2];
+        double up[2], down[2];
+        int last_empty[2];
+        for (int side = 0; side < 2; side++) {
+            up[side] = drain_time(sim, side, before[side]);
+            down[side] = drain_time(sim, side, before[side] - 1);
+            last_empty[side] = sim->booths[side * PER_SIDE + before[side] - 1].load == 0;
+        }
+        plaza_control(sim, started);
+        for (int side = 0; side < 2; side++) {
+            int open = sim->toll_open[side], first = side * PER_SIDE;
+            CHECK(open >= MIN_OPEN && open <= PER_SIDE, "side %d has %d booths open", side, open);
+            CHECK(open >= before[side] - 1 && open <= before[side] + 1, "side %d went from %d to %d booths", side,
+                  before[side], open);
+            if (open > before[side]) {
+                opened++;
+                CHECK(up[side] > config.toll_scale_up, "opened a booth with a %.3fs backlog", up[side]);
+                CHECK(started[side] < 0 || serving[first + before[side]] < 0, "new booth %d already served someone",
+                      first + before[side]);
+                if (started[side] >= 0) serving[first + before[side]] = started[side];
+                CHECK(sim->booths[first + before[side]].opened_at >= 0, "opened booth %d is not staffed",
+                      first + before[side]);
+            } else if (open < before[side]) {
+                closed++;
+                CHECK(down[side] < config.toll_scale_down, "closed a booth with a %.3fs backlog for the rest",
+                      down[side]);
+                CHECK(last_empty[side], "closed booth %d while vehicles queued at it", first + open);
+                CHECK(sim->booths[first + open].opened_at < 0, "closed empty booth %d is still staffed", first + open);
+            } else {
+                // Nothing changed: either a threshold wasn't crossed, or a bound or a busy last booth held it
+                CHECK(up[side] <= config.toll_scale_up || before[side] == PER_SIDE,
+                      "a %.3fs backlog left %d booths open", up[side], before[side]);
+                if (before[side] > MIN_OPEN && last_empty[side])
+                    CHECK(down[side] >= config.toll_scale_down, "a %.3fs backlog kept booth %d open", down[side],
+                          first + before[side] - 1);
+                held += up[side] > config.toll_scale_down && up[side] <= config.toll_scale_up;
+            }
+            reached_max |= open == PER_SIDE;
+            CHECK(started[side] < 0 || open > before[side], "side %d started vehicle %d without opening", side,
+                  started[side]);
+        }
+    }
+    // The scenario has to exercise each path for the checks above to mean anything
+    CHECK(opened > 0 && closed > 0 && held > 0 && reached_max, "opened %d, closed %d, held %d, reached max %d", opened,
+          closed, held, reached_max);
+
+    // A vehicle that chose a booth just before it closed: the booth is staffed
+    // again while it serves that vehicle, and only until then
+    int side = SIDE_A, booth = sim->toll_open[side];
+    CHECK(booth < PER_SIDE && sim->booths[booth].opened_at < 0 && serving[booth] < 0, "booth %d is not closed and idle",
+          booth);
+    int64_t staffed = booth_open_ns(sim, &sim->booths[booth]);
+    CHECK(booth_arrive(sim, booth, next_vehicle), "late vehicle queued at idle booth %d", booth);
+    CHECK(sim->booths[booth].opened_at >= 0, "booth %d unstaffed while serving", booth);
+    sim->sim_clock += 1;
+    CHECK(booth_leave(sim, booth) < 0, "booth %d had a queue", booth);
+    CHECK(sim->booths[booth].opened_at < 0, "booth %d still staffed after its last vehicle", booth);
+    CHECK(llabs(booth_open_ns(sim, &sim->booths[booth]) - staffed - 1000000000LL) < 1000,
+          "booth %d staffed %lld ns for a 1 s service", booth, (long long)(booth_open_ns(sim, &sim->booths[booth]) - staffed));
+
+    // Every booth's staffed time covers its serving time
+    for (int k = 0; k < 2 * PER_SIDE; k++)
+        CHECK(booth_open_ns(sim, &sim->booths[k]) >= sim->booths[k].busy_ns, "booth %d busy %lld ns, staffed %lld ns",
+              k, (long long)sim->booths[k].busy_ns, (long long)booth_open_ns(sim, &sim->booths[k]));
+    simulation_destroy(sim);
+    return check_result("test_plaza");
+}
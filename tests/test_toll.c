@@ -0,0 +1,85 @@
+// toll_choose: each policy against booth loads set by hand
+#include "check.h"
+
+#define PER_SIDE 6
+#define ROUNDS 20000
+
+Simulation *toll_simulation(int policy) {
+    SimConfig config = default_config;
+    config.toll_per_side = PER_SIDE;
+    config.toll_policy = policy;
+    config.event_mode = 1;
+    return simulation_create(&config);
+}
+
+// Loads from 0 to 4, so ties are common
+void shuffle_loads(Simulation *sim, RngStream *r) {
+    for (int k = 0; k < 2 * PER_SIDE; k++) sim->booths[k].load = rng_below(r, 5);
+}
+
+int main() {
+    RngStream loads, vehicle;
+    rng_seed(&loads, 1, 0);
+    rng_seed(&vehicle, 1, 1);
+
+    // Shortest queue: no open booth on the side has a shorter queue than the pick
+    Simulation *sim = toll_simulation(TOLL_SHORTEST);
+    for (int round = 0; round < ROUNDS; round++) {
+        int side = round & 1, first = side * PER_SIDE;
+        sim->toll_open[side] = 1 + round / 2 % PER_SIDE; // Every open count, as autoscaling leaves them
+        shuffle_loads(sim, &loads);
+        int booth = toll_choose(sim, side, &vehicle), shortest = INT_MAX;
+        for (int k = first; k < first + sim->toll_open[side]; k++)
+            if (sim->booths[k].load < shortest) shortest = sim->booths[k].load;
+        CHECK(booth >= first && booth < first + sim->toll_open[side], "side %d with %d open picked booth %d", side,
+              sim->toll_open[side], booth);
+        CHECK(sim->booths[booth].load == shortest, "picked a queue of %d, shortest is %d", sim->booths[booth].load,
+              shortest);
+    }
+    simulation_destroy(sim);
+
+    // Power of two choices: the pick is one of the two booths drawn from the
+    // vehicle's stream, and the shorter of them, so a longest queue is never
+    // picked over a shorter one
+    sim = toll_simulation(TOLL_TWO);
+    long picks[PER_SIDE] = {0};
+    for (int round = 0; round < ROUNDS; round++) {
+        int side = round & 1, first = side * PER_SIDE, n = 2 + round / 2 % (PER_SIDE - 1);
+        sim->toll_open[side] = n;
+        shuffle_loads(sim, &loads);
+        RngStream replay = vehicle;
+        int a = rng_below(&replay, n), b = rng_below(&replay, n - 1);
+        if (b >= a) b++;
+        int booth = toll_choose(sim, side, &vehicle) - first, longest = 0, longest_count = 0;
+        CHECK(booth == a || booth == b, "picked booth %d, sampled %d and %d", booth, a, b);
+        int other = booth == a ? b : a;
+        CHECK(sim->booths[first + booth].load <= sim->booths[first + other].load, "picked a queue of %d over %d",
+              sim->booths[first + booth].load, sim->booths[first + other].load);
+        for (int k = 0; k < n; k++) {
+            int load = sim->booths[first + k].load;
+            if (load > longest) {
+                longest = load;
+                longest_count = 0;
+            }
+            longest_count += load == longest;
+        }
+        CHECK(longest_count > 1 || sim->booths[first + booth].load < longest, "picked the only longest queue, %d",
+              longest);
+        if (n == PER_SIDE) picks[booth]++;
+    }
+    // Both samples come from every open booth, so every booth gets picked
+    for (int k = 0; k < PER_SIDE; k++) CHECK(picks[k] > 0, "booth %d never picked", k);
+    simulation_destroy(sim);
+
+    // Random: any open booth on the side, and nothing else
+    sim = toll_simulation(TOLL_RANDOM);
+    for (int round = 0; round < ROUNDS; round++) {
+        int side = round & 1, first = side * PER_SIDE;
+        sim->toll_open[side] = 1 + round / 2 % PER_SIDE;
+        int booth = toll_choose(sim, side, &vehicle);
+        CHECK(booth >= first && booth < first + sim->toll_open[side], "side %d with %d open picked booth %d", side,
+              sim->toll_open[side], booth);
+    }
+    simulation_destroy(sim);
+    return check_result("test_toll");
+}